@@ -2,7 +2,7 @@ case $TRAVIS_OS_NAME in
 linux)
   BUILD=$CXX-$VER
   COV=gcov-$VER
-  EXTRA=-pthread
+  EXTRA="-pthread -lrt"
   sudo add-apt-repository ppa:ubuntu-toolchain-r/test -y
   sudo apt-get update -qq
   sudo apt-get install $CXX-$VER -yq
@@ -1,96 +1,877 @@
 #ifndef LF_ALLOCATOR_HPP
 #define LF_ALLOCATOR_HPP
 
+#include "backoff.hpp"
+#include "futex.hpp"
 #include "memory.hpp"
 #include "utility.hpp"
+#include "vmem.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "prolog.inc"
 
-template <typename T>
-class allocator {
+// Where the node array comes from.
+// Except for heap, memory is reserved up front and committed on demand.
+// thp asks for transparent huge pages, and hugetlb for explicit ones.
+// Each falls back to the next weaker one if unavailable.
+enum struct backing {
+  heap,
+  reserve,
+  thp,
+  hugetlb
+};
+
+// Cache line layout of heads and nodes.
+// Alignment 1 leaves the natural alignment.
+// Aligned heads are padded to occupy whole cache lines.
+template <std::size_t HeadAlign, std::size_t NodeAlign>
+struct layout {
+  static constexpr std::size_t head_align = HeadAlign;
+  static constexpr std::size_t node_align = NodeAlign;
+};
+
+using packed = layout<1, 1>;
+using padded_heads = layout<cache_line, 1>;
+using padded = layout<cache_line, cache_line>;
+
+// Requests nodes to be linked up front by `thread_cnt` threads.
+struct parallel_init {
+  unsigned thread_cnt = std::thread::hardware_concurrency();
+};
+
+// Statistics policies. `no_stats` compiles counting away.
+// `striped_stats` keeps counters in `Stripes` cache lines indexed by thread,
+// so that threads update lines of their own, as long as there are
+// no more threads than stripes. Beyond that, threads share stripes.
+struct no_stats {};
+
+template <unsigned Stripes = 16>
+struct striped_stats {
+  static_assert(Stripes > 0);
+};
+
+inline constexpr unsigned retry_bucket_cnt = 5;
+
+struct allocator_stats {
+  std::uint64_t allocations{};
+  std::uint64_t deallocations{};
+  std::uint64_t live{};
+  std::uint64_t high_water{};
+  // Allocations that failed because the pool was exhausted.
+  std::uint64_t exhaustions{};
+  // Operations by CAS retries: 0, 1, 2-3, 4-7, 8 or more.
+  std::uint64_t retries[retry_bucket_cnt]{};
+};
+
+namespace impl {
+
+template <typename T, std::size_t Align>
+struct alignas(std::max(Align, alignof(T))) aligned: T {
+  using T::T;
+};
+
+template <typename Alloc, typename = void>
+struct layout_of {
+  using type = packed;
+};
+
+template <typename Alloc>
+struct layout_of<Alloc, std::void_t<typename Alloc::layout_type>> {
+  using type = typename Alloc::layout_type;
+};
+
+template <typename Alloc>
+using layout_of_t = typename layout_of<Alloc>::type;
+
+template <typename Alloc, typename = void>
+struct cp_of {
+  using type = cp_t;
+};
+
+template <typename Alloc>
+struct cp_of<Alloc, std::void_t<typename Alloc::cp_type>> {
+  using type = typename Alloc::cp_type;
+};
+
+template <typename Alloc>
+using cp_of_t = typename cp_of<Alloc>::type;
+
+template <typename Alloc, typename = void>
+struct backoff_of {
+  using type = no_backoff;
+};
+
+template <typename Alloc>
+struct backoff_of<Alloc, std::void_t<typename Alloc::backoff_type>> {
+  using type = typename Alloc::backoff_type;
+};
+
+template <typename Alloc>
+using backoff_of_t = typename backoff_of<Alloc>::type;
+
+struct no_count {
+  void operator++() noexcept {}
+};
+
+struct count {
+  unsigned n{};
+
+  void operator++() noexcept {
+    ++n;
+  }
+};
+
+template <typename Stats>
+class stat_counters;
+
+template <>
+class stat_counters<no_stats> {
+public:
+  using count_type = no_count;
+
+  static constexpr bool enabled = false;
+
+  void on_allocate(std::uint64_t, std::uint64_t, no_count) noexcept {}
+  void on_deallocate(std::uint64_t, no_count) noexcept {}
+  void clear() noexcept {}
+};
+
+// `top` of an allocation is one past the highest index handed out.
+// Free nodes go back to the head of the free list, in front of nodes
+// never handed out, so the highest index ever handed out tracks the peak
+// number of live nodes, and each stripe can track its own maximum.
+template <unsigned Stripes>
+class stat_counters<striped_stats<Stripes>> {
+public:
+  using count_type = count;
+
+  static constexpr bool enabled = true;
+
+  void on_allocate(
+   std::uint64_t n, std::uint64_t top, const count& attempts) noexcept {
+    auto& s = mine();
+    if (n) {
+      s.allocs.fetch_add(n, rlx);
+      auto t = s.top.load(rlx);
+      while (top > t && !s.top.compare_exchange_weak(t, top, rlx, rlx));
+    }
+    else s.exhaustions.fetch_add(1, rlx);
+    on_retry(s, attempts);
+  }
+
+  void on_deallocate(std::uint64_t n, const count& attempts) noexcept {
+    auto& s = mine();
+    s.deallocs.fetch_add(n, rlx);
+    on_retry(s, attempts);
+  }
+
+  // Must not run concurrently with other operations.
+  void clear() noexcept {
+    for (auto& s : stripes) {
+      s.allocs.store(0, rlx);
+      s.deallocs.store(0, rlx);
+      s.exhaustions.store(0, rlx);
+      s.top.store(0, rlx);
+      for (auto& r : s.retries) {
+        r.store(0, rlx);
+      }
+    }
+  }
+
+  allocator_stats sum() const noexcept {
+    allocator_stats res;
+    for (auto& s : stripes) {
+      res.allocations += s.allocs.load(rlx);
+      res.deallocations += s.deallocs.load(rlx);
+      res.exhaustions += s.exhaustions.load(rlx);
+      res.high_water = std::max<std::uint64_t>(res.high_water, s.top.load(rlx));
+      for (unsigned i = 0; i < retry_bucket_cnt; ++i) {
+        res.retries[i] += s.retries[i].load(rlx);
+      }
+    }
+    if (res.allocations > res.deallocations) {
+      res.live = res.allocations - res.deallocations;
+    }
+    return res;
+  }
+
+private:
+  struct alignas(cache_line) stripe {
+    std::atomic_uint64_t allocs{};
+    std::atomic_uint64_t deallocs{};
+    std::atomic_uint64_t exhaustions{};
+    std::atomic_uint64_t top{};
+    std::atomic_uint64_t retries[retry_bucket_cnt]{};
+  };
+
+  stripe& mine() noexcept {
+    return stripes[thread_index() % Stripes];
+  }
+
+  static void on_retry(stripe& s, const count& attempts) noexcept {
+    auto r = attempts.n ? attempts.n - 1 : 0;
+    auto i = r ? std::min(ilog2(r) + 1, retry_bucket_cnt - 1) : 0;
+    s.retries[i].fetch_add(1, rlx);
+  }
+
+  stripe stripes[Stripes];
+};
+
+template <
+ typename Backoff = no_backoff,
+ typename Cp,
+ typename Alloc,
+ typename Count = no_count>
+typename Cp::index_type pop(
+ std::atomic<Cp>& head,
+ Alloc& alloc,
+ Count&& attempts = {}) noexcept {
+  Cp newhd, hd(head.load(acq));
+  for (Backoff backoff;; backoff()) {
+    ++attempts;
+    if (hd.ptr == Cp::null) return Cp::null;
+    newhd.ptr = alloc.deref(hd.ptr).next.load(rlx);
+    newhd.cnt = hd.cnt + 1;
+    if (head.compare_exchange_weak(hd, newhd, acq, acq)) return hd.ptr;
+  }
+}
+
+template <
+ typename Backoff = no_backoff,
+ typename Cp,
+ typename Alloc,
+ typename Count = no_count>
+typename Cp::index_type pop_n(
+ std::atomic<Cp>& head,
+ Alloc& alloc,
+ typename Cp::index_type n,
+ typename Cp::index_type& out,
+ Count&& attempts = {}) noexcept {
+  using index_type = typename Cp::index_type;
+  Cp newhd, hd(head.load(acq));
+  index_type cnt, last;
+  for (Backoff backoff;; backoff()) {
+    ++attempts;
+    if (!n || hd.ptr == Cp::null) return 0;
+    cnt = 1;
+    last = hd.ptr;
+    newhd.ptr = alloc.deref(last).next.load(rlx);
+    while (cnt < n && newhd.ptr != Cp::null) {
+      ++cnt;
+      last = newhd.ptr;
+      newhd.ptr = alloc.deref(last).next.load(rlx);
+    }
+    newhd.cnt = hd.cnt + 1;
+    if (head.compare_exchange_weak(hd, newhd, acq, acq)) break;
+  }
+  alloc.deref(last).next.store(Cp::null, rlx);
+  out = hd.ptr;
+  return cnt;
+}
+
+template <
+ typename Backoff = no_backoff,
+ typename Cp,
+ typename Alloc,
+ typename Count = no_count>
+void push(
+ std::atomic<Cp>& head,
+ Alloc& alloc,
+ typename Cp::index_type first,
+ typename Cp::index_type last,
+ Count&& attempts = {}) noexcept {
+  auto&& nod = alloc.deref(last);
+  Cp newhd{first}, hd(head.load(rlx));
+  for (Backoff backoff;; backoff()) {
+    ++attempts;
+    nod.next.store(hd.ptr, rlx);
+    newhd.cnt = hd.cnt;
+    // seq_cst for callers that notify waiters after pushing.
+    if (head.compare_exchange_weak(hd, newhd, cst, rlx)) return;
+  }
+}
+
+template <typename Node, typename Index = std::uint32_t>
+class arena {
+public:
+  arena() noexcept = default;
+
+  arena(Index capacity, backing bk):
+   bk(bk),
+   cap(capacity),
+   ptr(acquire()) {
+    // nop
+  }
+
+  ~arena() {
+    release();
+  }
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+
+  void swap(arena& a) noexcept {
+    std::swap(bk, a.bk);
+    std::swap(cap, a.cap);
+    std::swap(len, a.len);
+    std::swap(ptr, a.ptr);
+  }
+
+  Node* data() const noexcept {
+    return ptr;
+  }
+
+  Index capacity() const noexcept {
+    return cap;
+  }
+
+  backing get_backing() const noexcept {
+    return bk;
+  }
+
+  std::size_t commit_base(Index first) const noexcept {
+    return sizeof(Node) * first / vm_page_size() * vm_page_size();
+  }
+
+  // Makes sure nodes below `n` are committed.
+  // `committed` is the byte offset below which commit is known to be done.
+  bool commit(std::atomic_size_t& committed, Index n) noexcept {
+    if (bk == backing::heap) return true;
+    auto end = sizeof(Node) * n;
+    auto c = committed.load(acq);
+    if (end <= c) return true;
+    auto newc = std::min(vm_round_up(end, vm_huge_page_size), len);
+    if (!vm_commit((char*)ptr + c, newc - c)) return false;
+    while (c < newc && !committed.compare_exchange_weak(c, newc, rel, acq));
+    return true;
+  }
+
+private:
+  Node* acquire() {
+#ifndef LF_HAS_VMEM
+    bk = backing::heap;
+#endif
+    if (bk == backing::heap) return allocate<Node>(cap);
+    if (!cap) return nullptr;
+    void* p = nullptr;
+    len = vm_round_up(sizeof(Node) * cap, vm_huge_page_size);
+    if (bk == backing::hugetlb && !(p = vm_reserve_huge(len))) {
+      bk = backing::thp;
+    }
+    if (bk == backing::thp && (p = vm_reserve(len, vm_huge_page_size))) {
+      if (!vm_advise_huge(p, len)) bk = backing::reserve;
+    }
+    if (!p) {
+      bk = backing::reserve;
+      len = vm_round_up(sizeof(Node) * cap, vm_page_size());
+      p = vm_reserve(len);
+    }
+    if (!p) throw std::bad_alloc();
+    return (Node*)p;
+  }
+
+  void release() noexcept {
+    if (bk == backing::heap) lf::deallocate(ptr);
+    else vm_release(ptr, len);
+  }
+
+  backing bk{backing::heap};
+  Index cap{};
+  std::size_t len{};
+  Node* ptr{};
+};
+
+// Nodes in [top, end) have never been handed out.
+// They are neither linked nor touched until the frontier reaches them,
+// which keeps construction O(1) and lets the allocating thread
+// first-touch their pages. `Nodes` is an arena, or anything with the same
+// `data()`, `commit()` and `commit_base()`.
+template <typename Cp = cp_t>
+class frontier {
+public:
+  using index_type = typename Cp::index_type;
+
+  template <typename Nodes>
+  void rewind(
+   const Nodes& nodes,
+   index_type first,
+   index_type last) noexcept {
+    top.store(first, rlx);
+    end = last;
+    committed.store(nodes.commit_base(first), rlx);
+  }
+
+  index_type remaining() const noexcept {
+    return end - top.load(rlx);
+  }
+
+  // Hands out up to `n` nodes without linking them.
+  template <typename Nodes>
+  index_type try_claim(
+   Nodes& nodes,
+   index_type n,
+   index_type& out) noexcept {
+    auto t = top.load(rlx);
+    index_type cnt;
+    do {
+      cnt = std::min(n, end - t);
+      if (!cnt || !nodes.commit(committed, t + cnt)) return 0;
+    }
+    while (!top.compare_exchange_weak(t, t + cnt, rlx, rlx));
+    out = t;
+    return cnt;
+  }
+
+  template <typename Nodes>
+  index_type try_bump(
+   Nodes& nodes,
+   index_type n,
+   index_type& out) noexcept {
+    auto cnt = try_claim(nodes, n, out);
+    if (!cnt) return 0;
+    auto p = nodes.data();
+    for (auto i = out + 1; i < out + cnt; ++i) {
+      init(&p[i - 1].next, i);
+    }
+    init(&p[out + cnt - 1].next, Cp::null);
+    return cnt;
+  }
+
+private:
+  std::atomic<index_type> top{};
+  index_type end{};
+  std::atomic_size_t committed{};
+};
+
+} // namespace impl
+
+// `Cp` sets the split between index and ABA counter bits.
+// Capacity must not exceed `Cp::null`.
+// `Backoff` is applied to failed CAS on the free list.
+// `Stats` is `no_stats` or `striped_stats<>`, the latter enabling `stats()`.
+template <
+ typename T,
+ typename Layout = packed,
+ typename Cp = cp_t,
+ typename Backoff = no_backoff,
+ typename Stats = no_stats>
+class allocator: private impl::stat_counters<Stats> {
+  static_assert(std::atomic<Cp>::is_always_lock_free);
+
+  using counters = impl::stat_counters<Stats>;
+  using count_type = typename counters::count_type;
+
 public:
-  struct node {
+  using layout_type = Layout;
+  using cp_type = Cp;
+  using backoff_type = Backoff;
+  using stats_type = Stats;
+  using index_type = typename Cp::index_type;
+
+  struct alignas(std::max({
+   Layout::node_align, alignof(T), alignof(std::atomic<index_type>)})) node {
     T val;
-    std::atomic_uint32_t next;
+    std::atomic<index_type> next;
   };
 
   allocator() noexcept = default;
 
-  explicit allocator(std::uint32_t capacity):
-   backup(allocate<node>(capacity)),
-   head(cp_t{capacity ? 0 : null}) {
-    link(capacity);
+  explicit allocator(index_type capacity, backing bk = backing::heap):
+   nodes(checked(capacity), bk) {
+    fr.rewind(nodes, 0, capacity);
   }
 
-  ~allocator() {
-    lf::deallocate(backup);
+  allocator(index_type capacity, backing bk, parallel_init init):
+   allocator(capacity, bk) {
+    populate(init.thread_cnt);
   }
 
   allocator(const allocator&) = delete;
   allocator& operator=(const allocator&) = delete;
 
-  void reset(std::uint32_t capacity) {
-    lf::deallocate(std::exchange(backup, allocate<node>(capacity)));
-    head.store({capacity ? 0 : null}, rlx);
-    link(capacity);
+  void reset(index_type capacity) {
+    reset(capacity, []() noexcept {});
   }
 
   template <typename F, typename... Args>
-  void reset(std::uint32_t capacity, F&& f, Args&&... args) {
-    auto newbackup = allocate<node>(capacity);
+  void reset(index_type capacity, F&& f, Args&&... args) {
+    impl::arena<node, index_type> newnodes(
+     checked(capacity), nodes.get_backing());
     std::invoke(std::forward<F>(f), std::forward<Args>(args)...);
-    lf::deallocate(std::exchange(backup, newbackup));
-    head.store({capacity ? 0 : null}, rlx);
-    link(capacity);
+    nodes.swap(newnodes);
+    head.store({}, rlx);
+    fr.rewind(nodes, 0, capacity);
+    counters::clear();
   }
 
-  std::uint32_t try_allocate() noexcept {
-    cp_t newhd, hd(head.load(acq));
-    do {
-      if (hd.ptr == null) return null;
-      auto& nod = deref(hd.ptr);
-      newhd.ptr = nod.next.load(rlx);
-      newhd.cnt = hd.cnt + 1;
-    }
-    while (!head.compare_exchange_weak(hd, newhd, rlx, acq));
-    return hd.ptr;
+  index_type try_allocate() noexcept {
+    count_type attempts;
+    auto p = impl::pop<Backoff>(head, *this, attempts);
+    if (p == Cp::null && !fr.try_bump(nodes, 1, p)) p = Cp::null;
+    counters::on_allocate(p != Cp::null, std::uint64_t(p) + 1, attempts);
+    return p;
+  }
+
+  index_type try_allocate_n(index_type n, index_type& out) noexcept {
+    count_type attempts;
+    auto cnt = impl::pop_n<Backoff>(head, *this, n, out, attempts);
+    if (!cnt) cnt = fr.try_bump(nodes, n, out);
+    if (n) counters::on_allocate(cnt, cnt ? top_of(out, cnt) : 0, attempts);
+    return cnt;
+  }
+
+  // Spins briefly, then blocks until a node is deallocated
+  // if the pool is exhausted. Nodes cached by magazines are not waited for.
+  index_type wait_allocate() noexcept {
+    index_type p;
+    auto allocated = [this, &p]() noexcept {
+      return (p = try_allocate()) != Cp::null;
+    };
+    freed.await(allocated, std::chrono::steady_clock::time_point::max());
+    return p;
   }
 
-  void deallocate(std::uint32_t p) noexcept {
+  template <typename Rep, typename Period>
+  index_type wait_allocate_for(
+   std::chrono::duration<Rep, Period> timeout) noexcept {
+    index_type p;
+    auto allocated = [this, &p]() noexcept {
+      return (p = try_allocate()) != Cp::null;
+    };
+    return freed.await(allocated, impl::deadline_after(timeout)) ? p : Cp::null;
+  }
+
+  void deallocate(index_type p) noexcept {
+    count_type attempts;
+    impl::push<Backoff>(head, *this, p, p, attempts);
+    counters::on_deallocate(1, attempts);
+    freed.notify(1);
+  }
+
+  void deallocate_chain(
+   index_type first, index_type last, index_type n) noexcept {
+    count_type attempts;
+    impl::push<Backoff>(head, *this, first, last, attempts);
+    counters::on_deallocate(n, attempts);
+    freed.notify(n < INT_MAX ? int(n) : INT_MAX);
+  }
+
+  node& deref(index_type ptr) noexcept {
+    return nodes.data()[ptr];
+  }
+
+  void del(index_type p) noexcept {
     auto& nod = deref(p);
-    cp_t newhd{p}, hd(head.load(rlx));
-    do {
-      nod.next.store(hd.ptr, rlx);
-      newhd.cnt = hd.cnt;
+    uninit(&nod.val);
+    deallocate(p);
+  }
+
+  // Links all never handed out nodes onto the free list up front.
+  // `thread_cnt` threads each link, and so first-touch, a contiguous slice,
+  // spreading pages over the memory of the nodes they run on.
+  // Must not run concurrently with other operations.
+  void populate(unsigned thread_cnt) {
+    index_type first;
+    auto n = fr.try_claim(nodes, fr.remaining(), first);
+    if (!n) return;
+    auto cnt = index_type(std::clamp<index_type>(thread_cnt, 1, n));
+    auto slice = (n - 1) / cnt + 1;
+    auto link = [this, first, n, slice](index_type k) noexcept {
+      auto p = nodes.data();
+      auto b = first + slice * k;
+      auto e = std::min(b + slice, first + n);
+      for (auto i = b; i < e; ++i) {
+        init(&p[i].next, i + 1 < first + n ? i + 1 : Cp::null);
+      }
+    };
+    std::vector<std::thread> threads;
+    index_type k = 1;
+    try {
+      threads.reserve(cnt - 1);
+      for (; k < cnt; ++k) {
+        threads.emplace_back(link, k);
+      }
+    }
+    catch (...) {
+      // Links what is left on this thread.
     }
-    while (!head.compare_exchange_weak(hd, newhd, rel, rlx));
+    for (auto j = k; j < cnt; ++j) {
+      link(j);
+    }
+    link(0);
+    for (auto& t : threads) {
+      t.join();
+    }
+    impl::push(head, *this, first, first + n - 1);
   }
 
-  node& deref(std::uint32_t ptr) noexcept {
-    return backup[ptr];
+  index_type capacity() const noexcept {
+    return nodes.capacity();
   }
 
-  void del(std::uint32_t p) noexcept {
-    auto& nod = deref(p);
+  backing get_backing() const noexcept {
+    return nodes.get_backing();
+  }
+
+  // Counters are aggregated over threads on read,
+  // so the result is not a snapshot under concurrent use.
+  // High-water mark is the peak number of live nodes. Racing allocations
+  // may overstate it slightly, and so may `populate()` after nodes have
+  // been handed out, as it puts never handed out nodes first.
+  allocator_stats stats() const noexcept {
+    static_assert(counters::enabled, "Enable with striped_stats.");
+    return counters::sum();
+  }
+
+private:
+  // One past the highest index in a chain, walked only if counted.
+  index_type top_of(
+   [[maybe_unused]] index_type p,
+   [[maybe_unused]] index_type n) noexcept {
+    index_type top = 0;
+    if constexpr (counters::enabled) {
+      while (n--) {
+        top = std::max<index_type>(top, p + 1);
+        p = deref(p).next.load(rlx);
+      }
+    }
+    return top;
+  }
+
+  static index_type checked(index_type capacity) {
+    if (capacity > Cp::null) {
+      throw std::length_error("lf::allocator: capacity exceeds index width.");
+    }
+    return capacity;
+  }
+
+  impl::arena<node, index_type> nodes;
+  impl::frontier<Cp> fr;
+  impl::aligned<std::atomic<Cp>, Layout::head_align> head{Cp{}};
+  impl::event_count freed;
+};
+
+// Bounded cache of free nodes in front of a shared allocator.
+// Not thread-safe. Remaining nodes are flushed back on destruction,
+// so it must not outlive the allocator, e.g., as a thread_local.
+// See `magazine_allocator` for per-thread caching.
+template <typename Alloc, std::uint32_t Size = 64>
+class magazine {
+  static_assert(Size >= 2);
+
+public:
+  using index_type = typename impl::cp_of_t<Alloc>::index_type;
+
+  explicit magazine(Alloc& alloc) noexcept:
+   alloc(alloc) {
+    // nop
+  }
+
+  ~magazine() {
+    flush();
+  }
+
+  magazine(const magazine&) = delete;
+  magazine& operator=(const magazine&) = delete;
+
+  index_type try_allocate() noexcept {
+    if (!cnt) refill();
+    return cnt ? slot[--cnt] : null_index;
+  }
+
+  void deallocate(index_type p) noexcept {
+    if (cnt == Size) drain(Size / 2);
+    slot[cnt++] = p;
+  }
+
+  decltype(auto) deref(index_type ptr) noexcept {
+    return alloc.deref(ptr);
+  }
+
+  void del(index_type p) noexcept {
+    auto&& nod = deref(p);
     uninit(&nod.val);
     deallocate(p);
   }
 
+  void flush() noexcept {
+    drain(cnt);
+  }
+
 private:
-  void link(std::uint32_t capacity) noexcept {
-    if (!capacity) return;
-    std::uint32_t i = 0, ni = 1;
-    while (ni < capacity) {
-      init(&backup[i].next, ni);
-      i = ni++;
+  static constexpr auto null_index = impl::cp_of_t<Alloc>::null;
+
+  void refill() noexcept {
+    index_type p;
+    auto n = alloc.try_allocate_n(Size / 2, p);
+    while (n--) {
+      slot[cnt++] = p;
+      p = deref(p).next.load(rlx);
+    }
+  }
+
+  void drain(std::uint32_t n) noexcept {
+    if (!n) return;
+    auto last = slot[--cnt];
+    for (auto i = n; --i; --cnt) {
+      deref(slot[cnt - 1]).next.store(slot[cnt], rlx);
+    }
+    alloc.deallocate_chain(slot[cnt], last, n);
+  }
+
+  Alloc& alloc;
+  std::uint32_t cnt{};
+  index_type slot[Size];
+};
+
+// Allocator adapter that owns a shared allocator and a magazine per
+// thread slot in front of it, so that most allocations and deallocations
+// touch no shared line. A thread uses slot `thread_index() % slot_cnt`
+// unless another thread of the slot holds it at the moment,
+// in which case it goes to the shared allocator.
+// When both come up empty, idle slots are flushed to the shared allocator
+// before the allocation fails.
+template <typename T, std::uint32_t Size = 64, typename Alloc = allocator<T>>
+class magazine_allocator {
+public:
+  using base_type = Alloc;
+  using node = typename Alloc::node;
+  using layout_type = impl::layout_of_t<Alloc>;
+  using cp_type = impl::cp_of_t<Alloc>;
+  using backoff_type = impl::backoff_of_t<Alloc>;
+  using index_type = typename cp_type::index_type;
+
+  template <typename... Args>
+  explicit magazine_allocator(
+   index_type capacity,
+   unsigned slot_cnt = default_slot_cnt(),
+   Args&&... args):
+   pool(capacity, std::forward<Args>(args)...),
+   cnt(slot_cnt ? slot_cnt : 1),
+   slots(allocate<slot>(cnt)) {
+    for (unsigned i = 0; i < cnt; ++i) {
+      init(slots + i, pool);
+    }
+  }
+
+  ~magazine_allocator() {
+    for (unsigned i = 0; i < cnt; ++i) {
+      uninit(slots + i);
+    }
+    lf::deallocate(slots);
+  }
+
+  magazine_allocator(const magazine_allocator&) = delete;
+  magazine_allocator& operator=(const magazine_allocator&) = delete;
+
+  static unsigned default_slot_cnt() noexcept {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  index_type try_allocate() noexcept {
+    auto& s = mine();
+    index_type p;
+    if (s.busy.test_and_set(acq)) {
+      p = pool.try_allocate();
+    }
+    else {
+      p = s.mag.try_allocate();
+      s.busy.clear(rel);
+    }
+    if (p != cp_type::null) return p;
+    reclaim();
+    return pool.try_allocate();
+  }
+
+  index_type try_allocate_n(index_type n, index_type& out) noexcept {
+    auto cnt = pool.try_allocate_n(n, out);
+    if (cnt || !n) return cnt;
+    reclaim();
+    return pool.try_allocate_n(n, out);
+  }
+
+  void deallocate(index_type p) noexcept {
+    auto& s = mine();
+    if (s.busy.test_and_set(acq)) {
+      pool.deallocate(p);
+      return;
+    }
+    s.mag.deallocate(p);
+    s.busy.clear(rel);
+  }
+
+  void deallocate_chain(
+   index_type first, index_type last, index_type n) noexcept {
+    pool.deallocate_chain(first, last, n);
+  }
+
+  decltype(auto) deref(index_type ptr) noexcept {
+    return pool.deref(ptr);
+  }
+
+  void del(index_type p) noexcept {
+    auto&& nod = deref(p);
+    uninit(&nod.val);
+    deallocate(p);
+  }
+
+  // Returns all cached nodes to the shared allocator.
+  // Must not run concurrently with other operations.
+  void flush() noexcept {
+    for (unsigned i = 0; i < cnt; ++i) {
+      slots[i].mag.flush();
+    }
+  }
+
+  index_type capacity() const noexcept {
+    return pool.capacity();
+  }
+
+  unsigned slot_cnt() const noexcept {
+    return cnt;
+  }
+
+  Alloc& base() noexcept {
+    return pool;
+  }
+
+private:
+  struct alignas(cache_line) slot {
+    explicit slot(Alloc& alloc) noexcept:
+     mag(alloc) {
+      // nop
+    }
+
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    magazine<Alloc, Size> mag;
+  };
+
+  slot& mine() noexcept {
+    return slots[thread_index() % cnt];
+  }
+
+  // Flushes every slot not in use back to the shared allocator,
+  // so that nodes cached by other threads are not lost to a miss.
+  void reclaim() noexcept {
+    for (unsigned i = 0; i < cnt; ++i) {
+      auto& s = slots[i];
+      if (s.busy.test_and_set(acq)) continue;
+      s.mag.flush();
+      s.busy.clear(rel);
     }
-    init(&backup[i].next, null);
   }
 
-  node* backup{};
-  std::atomic<cp_t> head{cp_t{}};
+  Alloc pool;
+  unsigned cnt;
+  slot* slots;
 };
 
 #include "epilog.inc"
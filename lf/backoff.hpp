@@ -0,0 +1,85 @@
+#ifndef LF_BACKOFF_HPP
+#define LF_BACKOFF_HPP
+
+#include <algorithm>
+
+#include "prolog.inc"
+
+// Hints the CPU that the caller is spinning.
+inline
+void cpu_relax() noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Backoff policies are constructed once per operation,
+// and invoked after each failed CAS.
+
+struct no_backoff {
+  void operator()() noexcept {}
+};
+
+// Pauses `Min` times after the first failure,
+// doubling after each further failure up to `Max`.
+template <unsigned Min = 4, unsigned Max = 1024>
+class exp_backoff {
+  static_assert(0 < Min && Min <= Max);
+
+public:
+  void operator()() noexcept {
+    for (auto i = n; i; --i) {
+      cpu_relax();
+    }
+    n = std::min(n * 2, Max);
+  }
+
+  // Pauses of the next call.
+  unsigned spins() const noexcept {
+    return n;
+  }
+
+private:
+  unsigned n{Min};
+};
+
+// Like `exp_backoff`, but starts from a per-thread limit learned from
+// past operations. The limit doubles on every failure,
+// and halves on operations that succeed at first try.
+template <unsigned Min = 1, unsigned Max = 1024>
+class adaptive_backoff {
+  static_assert(0 < Min && Min <= Max);
+
+public:
+  adaptive_backoff() noexcept = default;
+
+  ~adaptive_backoff() {
+    if (!failed) limit = std::max(limit / 2, Min);
+  }
+
+  adaptive_backoff(const adaptive_backoff&) = delete;
+  adaptive_backoff& operator=(const adaptive_backoff&) = delete;
+
+  void operator()() noexcept {
+    failed = true;
+    for (auto i = limit; i; --i) {
+      cpu_relax();
+    }
+    limit = std::min(limit * 2, Max);
+  }
+
+  // Pauses of the next call on this thread.
+  static unsigned spins() noexcept {
+    return limit;
+  }
+
+private:
+  inline static thread_local unsigned limit{Min};
+  bool failed{};
+};
+
+#include "epilog.inc"
+
+#endif // LF_BACKOFF_HPP
@@ -0,0 +1,154 @@
+#ifndef LF_FUTEX_HPP
+#define LF_FUTEX_HPP
+
+#include "backoff.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+  #define LF_HAS_FUTEX 1
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+  #include <ctime>
+#endif
+
+#include "prolog.inc"
+
+// Futexes are not private to the process,
+// so that waiting works on words in shared memory.
+// Elsewhere, waiting falls back to polling with short sleeps.
+
+static_assert(sizeof(std::atomic_uint32_t) == sizeof(std::uint32_t));
+
+namespace impl {
+
+inline constexpr auto futex_poll = std::chrono::microseconds(50);
+
+} // namespace impl
+
+// Blocks while `word` holds `expected`. May return spuriously.
+inline
+void futex_wait(std::atomic_uint32_t& word, std::uint32_t expected) noexcept {
+#ifdef LF_HAS_FUTEX
+  syscall(SYS_futex, &word, FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#else
+  if (word.load(std::memory_order_relaxed) == expected) {
+    std::this_thread::sleep_for(impl::futex_poll);
+  }
+#endif
+}
+
+// Like `futex_wait()`, but for at most `timeout`.
+inline
+void futex_wait_for(
+ std::atomic_uint32_t& word,
+ std::uint32_t expected,
+ std::chrono::nanoseconds timeout) noexcept {
+  if (timeout <= timeout.zero()) return;
+#ifdef LF_HAS_FUTEX
+  using namespace std::chrono;
+  auto s = duration_cast<seconds>(timeout);
+  timespec ts;
+  ts.tv_sec = (std::time_t)s.count();
+  ts.tv_nsec = (long)(timeout - s).count();
+  syscall(SYS_futex, &word, FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+  if (word.load(std::memory_order_relaxed) == expected) {
+    std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+     timeout, impl::futex_poll));
+  }
+#endif
+}
+
+// Wakes up to `n` threads blocked on `word`.
+inline
+void futex_wake(std::atomic_uint32_t& word, int n = INT_MAX) noexcept {
+#ifdef LF_HAS_FUTEX
+  syscall(SYS_futex, &word, FUTEX_WAKE, n, nullptr, nullptr, 0);
+#else
+  (void)word;
+  (void)n;
+#endif
+}
+
+namespace impl {
+
+// Saturates at `time_point::max()`, which waits without a deadline,
+// rather than overflowing for huge timeouts.
+template <typename Rep, typename Period>
+std::chrono::steady_clock::time_point deadline_after(
+ std::chrono::duration<Rep, Period> timeout) noexcept {
+  using clock = std::chrono::steady_clock;
+  using secs = std::chrono::duration<double>;
+  auto now = clock::now();
+  if (timeout <= timeout.zero()) return now;
+  if (secs(timeout) >= secs(clock::time_point::max() - now)) {
+    return clock::time_point::max();
+  }
+  return now + std::chrono::ceil<clock::duration>(timeout);
+}
+
+// Lets threads wait for a condition that others make true,
+// costing the latter a single load while nobody waits.
+// The update making the condition true must be seq_cst,
+// or be followed by a seq_cst fence, before calling `notify()`.
+class event_count {
+public:
+  static constexpr unsigned spins = 64;
+
+  // Waits until `f()` succeeds or `deadline` passes.
+  // A waiter registers in `waiters` before retrying `f()`, and notifiers
+  // check `waiters` after their update. So either the retry sees the update,
+  // or the notifier sees the waiter and bumps `seq` to end its futex wait.
+  template <typename F>
+  bool await(F&& f, std::chrono::steady_clock::time_point deadline) noexcept {
+    using clock = std::chrono::steady_clock;
+    for (auto i = spins; i; --i) {
+      if (f()) return true;
+      cpu_relax();
+    }
+    for (;;) {
+      waiters.fetch_add(1, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto s = seq.load(std::memory_order_acquire);
+      if (f()) {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+      auto now = clock::now();
+      if (now >= deadline) {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+      }
+      if (deadline == clock::time_point::max()) futex_wait(seq, s);
+      else futex_wait_for(seq, s, deadline - now);
+      waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  void notify(int n) noexcept {
+    if (!waiters.load(std::memory_order_seq_cst)) return;
+    seq.fetch_add(1, std::memory_order_release);
+    futex_wake(seq, n);
+  }
+
+  // Drops waiters left behind by dead processes. Requires exclusive access.
+  void clear() noexcept {
+    waiters.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic_uint32_t waiters{};
+  std::atomic_uint32_t seq{};
+};
+
+} // namespace impl
+
+#include "epilog.inc"
+
+#endif // LF_FUTEX_HPP
@@ -0,0 +1,175 @@
+#ifndef LF_GROWABLE_ALLOCATOR_HPP
+#define LF_GROWABLE_ALLOCATOR_HPP
+
+#include "allocator.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "prolog.inc"
+
+// Index space is split into segments of geometrically growing size.
+// Segment k holds indices [b * (2^k - 1), b * (2^(k+1) - 1)),
+// where b is the initial capacity rounded up to a power of two.
+template <typename T>
+class growable_allocator {
+public:
+  using node = typename allocator<T>::node;
+
+  growable_allocator() noexcept = default;
+
+  explicit growable_allocator(std::uint32_t capacity):
+   shift(capacity > 1 ? std::min(ilog2(capacity - 1) + 1, 31u) : 0) {
+    if (capacity && !try_grow(0)) throw std::bad_alloc();
+  }
+
+  ~growable_allocator() {
+    for (auto& s : seg) {
+      lf::deallocate(s.load(rlx));
+    }
+  }
+
+  growable_allocator(const growable_allocator&) = delete;
+  growable_allocator& operator=(const growable_allocator&) = delete;
+
+  std::uint32_t capacity() const noexcept {
+    return std::uint32_t(((std::uint64_t(1) << ready.load(acq)) - 1) << shift);
+  }
+
+  // Adds one segment past the current ones, or waits for a concurrent grow.
+  bool try_grow() noexcept {
+    return try_grow(ready.load(acq));
+  }
+
+  std::uint32_t try_allocate() noexcept {
+    std::uint32_t p;
+    do {
+      auto r = ready.load(acq);
+      p = impl::pop(head, *this);
+      if (p != null) return p;
+      if (r && bump(r - 1, 1, p)) return p;
+      if (!try_grow(r)) return null;
+    }
+    while (true);
+  }
+
+  std::uint32_t try_allocate_n(std::uint32_t n, std::uint32_t& out) noexcept {
+    if (!n) return 0;
+    do {
+      auto r = ready.load(acq);
+      auto cnt = impl::pop_n(head, *this, n, out);
+      if (cnt) return cnt;
+      if (r && (cnt = bump(r - 1, n, out))) return cnt;
+      if (!try_grow(r)) return 0;
+    }
+    while (true);
+  }
+
+  void deallocate(std::uint32_t p) noexcept {
+    impl::push(head, *this, p, p);
+  }
+
+  void deallocate_chain(
+   std::uint32_t first, std::uint32_t last, std::uint32_t /*n*/) noexcept {
+    impl::push(head, *this, first, last);
+  }
+
+  node& deref(std::uint32_t ptr) noexcept {
+    auto i = ptr + (std::uint64_t(1) << shift);
+    auto k = ilog2(i);
+    return seg[k - shift].load(rlx)[i - (std::uint64_t(1) << k)];
+  }
+
+  void del(std::uint32_t p) noexcept {
+    auto& nod = deref(p);
+    uninit(&nod.val);
+    deallocate(p);
+  }
+
+private:
+  // Lets a segment stand in for an arena under `impl::frontier`.
+  // Segments are committed up front, so `commit` never fails.
+  struct segment_view {
+    struct nodes {
+      node& operator[](std::uint32_t i) const noexcept {
+        return p[i - first];
+      }
+
+      node* p;
+      std::uint32_t first;
+    };
+
+    nodes data() const noexcept {
+      return {p, first};
+    }
+
+    std::size_t commit_base(std::uint32_t) const noexcept {
+      return 0;
+    }
+
+    bool commit(std::atomic_size_t&, std::uint32_t) const noexcept {
+      return true;
+    }
+
+    node* p;
+    std::uint32_t first;
+  };
+
+  std::uint32_t segment_begin(std::uint32_t k) const noexcept {
+    return std::uint32_t(((std::uint64_t(1) << k) - 1) << shift);
+  }
+
+  segment_view view(std::uint32_t k) const noexcept {
+    return {seg[k].load(rlx), segment_begin(k)};
+  }
+
+  // Grows from `seen` segments to `seen + 1`.
+  // Only the thread that reserves segment `seen` allocates it;
+  // the others wait for it and then retry their pop.
+  bool try_grow(std::uint32_t seen) noexcept {
+    auto k = seen;
+    if (k == 32 - shift) return false;
+    if (!reserved.compare_exchange_strong(k, k + 1, acq, rlx)) {
+      while (ready.load(acq) <= seen && reserved.load(acq) > seen) {
+        std::this_thread::yield();
+      }
+      return ready.load(acq) > seen;
+    }
+    auto n = std::uint32_t(1) << (shift + k);
+    auto p = lf::try_allocate<node>(n);
+    if (!p) {
+      reserved.store(k, rel);
+      return false;
+    }
+    seg[k].store(p, rlx);
+    if (k) drain(k - 1);
+    fr[k].rewind(view(k), segment_begin(k), segment_begin(k) + n);
+    ready.store(k + 1, rel);
+    return true;
+  }
+
+  std::uint32_t bump(
+   std::uint32_t k, std::uint32_t n, std::uint32_t& out) noexcept {
+    auto v = view(k);
+    return fr[k].try_bump(v, n, out);
+  }
+
+  // Moves nodes left on an older frontier to the free list,
+  // as allocation only bumps the newest one.
+  void drain(std::uint32_t k) noexcept {
+    std::uint32_t first;
+    auto n = bump(k, fr[k].remaining(), first);
+    if (n) impl::push(head, *this, first, first + n - 1);
+  }
+
+  std::uint32_t shift{};
+  std::atomic_uint32_t reserved{};
+  std::atomic_uint32_t ready{};
+  std::atomic<node*> seg[32]{};
+  impl::frontier<> fr[32];
+  std::atomic<cp_t> head{cp_t{}};
+};
+
+#include "epilog.inc"
+
+#endif // LF_GROWABLE_ALLOCATOR_HPP
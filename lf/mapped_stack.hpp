@@ -0,0 +1,342 @@
+#ifndef LF_MAPPED_STACK_HPP
+#define LF_MAPPED_STACK_HPP
+
+#include "stack.hpp"
+
+#ifndef LF_HAS_VMEM
+  #error "Requires POSIX memory mapping."
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "prolog.inc"
+
+template <typename T>
+class mapped_stack;
+
+// Allocator whose state and nodes can live in memory mapped at different
+// addresses by different processes. Nodes are located by their offset
+// from the allocator object rather than by pointer.
+template <typename T>
+class mapped_allocator {
+public:
+  using node = typename allocator<T>::node;
+
+  mapped_allocator(std::uint32_t capacity, void* nodes) noexcept:
+   off((char*)nodes - (char*)this),
+   cap(capacity) {
+    // nop
+  }
+
+  mapped_allocator(const mapped_allocator&) = delete;
+  mapped_allocator& operator=(const mapped_allocator&) = delete;
+
+  std::uint32_t capacity() const noexcept {
+    return cap;
+  }
+
+  std::uint32_t try_allocate() noexcept {
+    auto p = impl::pop(head, *this);
+    return p != null ? p : try_bump(1, p) ? p : null;
+  }
+
+  std::uint32_t try_allocate_n(std::uint32_t n, std::uint32_t& out) noexcept {
+    auto cnt = impl::pop_n(head, *this, n, out);
+    return cnt ? cnt : try_bump(n, out);
+  }
+
+  void deallocate(std::uint32_t p) noexcept {
+    impl::push(head, *this, p, p);
+  }
+
+  void deallocate_chain(
+   std::uint32_t first, std::uint32_t last, std::uint32_t /*n*/) noexcept {
+    impl::push(head, *this, first, last);
+  }
+
+  node& deref(std::uint32_t ptr) noexcept {
+    return ((node*)((char*)this + off))[ptr];
+  }
+
+  void del(std::uint32_t p) noexcept {
+    auto& nod = deref(p);
+    uninit(&nod.val);
+    deallocate(p);
+  }
+
+private:
+  template <typename>
+  friend class mapped_stack;
+
+  std::uint32_t try_bump(std::uint32_t n, std::uint32_t& out) noexcept {
+    auto t = top.load(rlx);
+    std::uint32_t cnt;
+    do {
+      cnt = std::min(n, cap - t);
+      if (!cnt) return 0;
+    }
+    while (!top.compare_exchange_weak(t, t + cnt, rlx, rlx));
+    for (auto i = t + 1; i < t + cnt; ++i) {
+      init(&deref(i - 1).next, i);
+    }
+    init(&deref(t + cnt - 1).next, null);
+    out = t;
+    return cnt;
+  }
+
+  std::ptrdiff_t off;
+  std::uint32_t cap;
+  std::atomic_uint32_t top{};
+  std::atomic<cp_t> head{cp_t{}};
+};
+
+// Handle to a stack of trivially copyable values living, together with its
+// allocator, in a shared memory segment, so that multiple processes
+// can push/pop through it concurrently.
+// The segment is either a named POSIX shared memory object, a memfd,
+// or a regular file that persists the stack across restarts.
+template <typename T>
+class mapped_stack {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  using stack_type = waitable_stack<T, mapped_allocator<T>>;
+
+  static mapped_stack create_shm(const char* name, std::uint32_t capacity) {
+    mapped_stack ms(shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600));
+    ms.init(capacity);
+    return ms;
+  }
+
+  static mapped_stack open_shm(const char* name) {
+    mapped_stack ms(shm_open(name, O_RDWR, 0));
+    ms.map_existing();
+    return ms;
+  }
+
+  static void unlink_shm(const char* name) noexcept {
+    shm_unlink(name);
+  }
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  static mapped_stack create_memfd(std::uint32_t capacity) {
+    mapped_stack ms(memfd_create("lf::mapped_stack", MFD_CLOEXEC));
+    ms.init(capacity);
+    return ms;
+  }
+#endif
+
+  // Opens the file at `path`, creating it with `capacity` if empty.
+  // The file is locked for exclusive use by this handle.
+  // If the previous user did not shut down cleanly, recover() is run.
+  static mapped_stack open_file(const char* path, std::uint32_t capacity) {
+    mapped_stack ms(::open(path, O_RDWR | O_CREAT, 0600));
+    if (flock(ms.fd, LOCK_EX | LOCK_NB) != 0) {
+      throw std::system_error(errno, std::generic_category());
+    }
+    struct stat st;
+    if (fstat(ms.fd, &st) != 0) {
+      throw std::system_error(errno, std::generic_category());
+    }
+    if (st.st_size) {
+      ms.map_existing();
+      if (ms.hdr().dirty.load(rlx)) ms.recover();
+    }
+    else {
+      ms.init(capacity);
+    }
+    // The dirty mark must be on disk before the list is mutated.
+    ms.hdr().dirty.store(1, rlx);
+    if (!ms.sync_header()) {
+      throw std::system_error(errno, std::generic_category());
+    }
+    ms.file = true;
+    return ms;
+  }
+
+  // Attaches to a segment by file descriptor, e.g., one received from
+  // another process. `fd` is duplicated.
+  static mapped_stack attach(int fd) {
+    mapped_stack ms(dup(fd));
+    ms.map_existing();
+    return ms;
+  }
+
+  mapped_stack(mapped_stack&& ms) noexcept:
+   fd(std::exchange(ms.fd, -1)),
+   base(std::exchange(ms.base, nullptr)),
+   len(std::exchange(ms.len, 0)),
+   file(std::exchange(ms.file, false)) {
+    // nop
+  }
+
+  mapped_stack& operator=(mapped_stack ms) noexcept {
+    std::swap(fd, ms.fd);
+    std::swap(base, ms.base);
+    std::swap(len, ms.len);
+    std::swap(file, ms.file);
+    return *this;
+  }
+
+  ~mapped_stack() {
+    if (base) {
+      if (file) {
+        // The list must be on disk before the clean mark is.
+        if (msync(base, len, MS_SYNC) == 0) {
+          hdr().dirty.store(0, rlx);
+          sync_header();
+        }
+      }
+      munmap(base, len);
+    }
+    if (fd != -1) close(fd);
+  }
+
+  // Repairs the stack after an unclean shutdown.
+  // The stack list is cut at the first out-of-range or repeated link,
+  // and the free list is rebuilt from all touched nodes not on the stack,
+  // reclaiming nodes that were in flight. Requires exclusive access.
+  // A process that dies inside `wait_pop()` stays counted as a waiter,
+  // making pushes wake the futex needlessly, until this is run. File mode
+  // runs it on open after an unclean shutdown, but shm mode never does.
+  void recover() {
+    auto& stk = **this;
+    auto& alloc = stk.alloc;
+    auto top = std::min(alloc.top.load(rlx), alloc.cap);
+    std::vector<bool> used(top);
+    auto p = stk.head.load(rlx).ptr;
+    if (p != null && p >= top) {
+      stk.head.store({}, rlx);
+      p = null;
+    }
+    while (p != null) {
+      used[p] = true;
+      auto& next = alloc.deref(p).next;
+      auto q = next.load(rlx);
+      if (q != null && (q >= top || used[q])) {
+        next.store(null, rlx);
+        q = null;
+      }
+      p = q;
+    }
+    cp_t free;
+    for (auto i = top; i--;) {
+      if (used[i]) continue;
+      alloc.deref(i).next.store(free.ptr, rlx);
+      free.ptr = i;
+    }
+    alloc.head.store(free, rlx);
+    alloc.top.store(top, rlx);
+    stk.clear_waiters();
+  }
+
+  int native_handle() const noexcept {
+    return fd;
+  }
+
+  stack_type& operator*() const noexcept {
+    return *(stack_type*)((char*)base + stack_off);
+  }
+
+  stack_type* operator->() const noexcept {
+    return &**this;
+  }
+
+private:
+  using node = typename mapped_allocator<T>::node;
+
+  struct header {
+    std::atomic_uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t node_size;
+    std::uint32_t capacity;
+    std::atomic_uint32_t dirty;
+    std::uint32_t stack_size;
+    std::uint32_t nodes_offset;
+  };
+
+  static constexpr std::uint64_t magic = 0x4b434154535f464c; // "LF_STACK"
+  static constexpr std::uint32_t version = 3;
+  static constexpr std::size_t stack_off =
+    vm_round_up(sizeof(header), cache_line);
+  static constexpr std::size_t nodes_off =
+    vm_round_up(stack_off + sizeof(stack_type), cache_line);
+
+  static_assert(alignof(stack_type) <= cache_line);
+  static_assert(alignof(node) <= cache_line);
+
+  explicit mapped_stack(int fd):
+   fd(fd) {
+    if (fd == -1) throw std::system_error(errno, std::generic_category());
+  }
+
+  header& hdr() const noexcept {
+    return *(header*)base;
+  }
+
+  bool sync_header() noexcept {
+    return msync(base, std::min(vm_page_size(), len), MS_SYNC) == 0;
+  }
+
+  void map(std::size_t size) {
+    auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) throw std::system_error(errno, std::generic_category());
+    base = p;
+    len = size;
+  }
+
+  void init(std::uint32_t capacity) {
+    auto size = nodes_off + sizeof(node) * capacity;
+    if (ftruncate(fd, (off_t)size) != 0) {
+      throw std::system_error(errno, std::generic_category());
+    }
+    map(size);
+    auto p = (header*)base;
+    lf::init(p);
+    auto& h = *p;
+    h.version = version;
+    h.node_size = sizeof(node);
+    h.capacity = capacity;
+    h.stack_size = sizeof(stack_type);
+    h.nodes_offset = nodes_off;
+    lf::init(&**this, capacity, (char*)base + nodes_off);
+    h.magic.store(magic, rel);
+  }
+
+  void map_existing() {
+    struct stat st;
+    if (fstat(fd, &st) != 0) throw std::system_error(errno, std::generic_category());
+    if ((std::size_t)st.st_size < nodes_off) {
+      throw std::runtime_error("lf::mapped_stack: segment too small.");
+    }
+    map((std::size_t)st.st_size);
+    auto& h = hdr();
+    if (h.magic.load(acq) != magic ||
+        h.version != version ||
+        h.node_size != sizeof(node) ||
+        h.stack_size != sizeof(stack_type) ||
+        h.nodes_offset != nodes_off ||
+        len < nodes_off + sizeof(node) * h.capacity) {
+      throw std::runtime_error("lf::mapped_stack: incompatible segment.");
+    }
+  }
+
+  int fd{-1};
+  void* base{};
+  std::size_t len{};
+  bool file{};
+};
+
+#include "epilog.inc"
+
+#endif // LF_MAPPED_STACK_HPP
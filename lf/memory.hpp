@@ -20,11 +20,33 @@ struct paren_initable<decltype((void)T(std::declval<Us>()...)), T, Us...>
 template <typename T, typename... Us>
 inline constexpr bool paren_initable_v = paren_initable<void, T, Us...>::value;
 
+template <typename T>
+inline constexpr bool over_aligned_v =
+ alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
 } // namespace impl
 
 template <typename T>
 T* allocate(std::size_t n = 1) {
-  return n ? (T*)operator new(sizeof(T) * n) : (T*)nullptr;
+  if (!n) return nullptr;
+  if constexpr (impl::over_aligned_v<T>) {
+    return (T*)operator new(sizeof(T) * n, std::align_val_t(alignof(T)));
+  }
+  else {
+    return (T*)operator new(sizeof(T) * n);
+  }
+}
+
+template <typename T>
+T* try_allocate(std::size_t n = 1) noexcept {
+  if (!n) return nullptr;
+  if constexpr (impl::over_aligned_v<T>) {
+    return (T*)operator new(
+     sizeof(T) * n, std::align_val_t(alignof(T)), std::nothrow);
+  }
+  else {
+    return (T*)operator new(sizeof(T) * n, std::nothrow);
+  }
 }
 
 inline
@@ -32,6 +54,17 @@ void deallocate(void* p) noexcept {
   operator delete(p);
 }
 
+// Pairs with `allocate<T>()` and `try_allocate<T>()` for over-aligned `T`.
+template <typename T>
+void deallocate(T* p) noexcept {
+  if constexpr (impl::over_aligned_v<T>) {
+    operator delete((void*)p, std::align_val_t(alignof(T)));
+  }
+  else {
+    operator delete((void*)p);
+  }
+}
+
 template <typename T, typename... Args>
 void init(T*& p, Args&&... args) {
   if constexpr (impl::paren_initable_v<T, Args...>) {
@@ -0,0 +1,53 @@
+#ifndef LF_NUMA_ALLOCATOR_HPP
+#define LF_NUMA_ALLOCATOR_HPP
+
+#include "sharded_allocator.hpp"
+
+#include "prolog.inc"
+
+struct numa_home {
+  std::uint32_t operator()(std::uint32_t shard_cnt) const noexcept {
+    thread_local std::uint32_t node, countdown = 0;
+    if (!countdown--) {
+      node = vm_numa_node();
+      countdown = 4096;
+    }
+    return node % shard_cnt;
+  }
+};
+
+// One shard per NUMA node. Each shard's slice of the node array is
+// placed on its node via mbind() where available, and by first touch
+// from the (local) allocating thread otherwise.
+template <typename T>
+class numa_allocator: public sharded_allocator<T, numa_home> {
+  using base = sharded_allocator<T, numa_home>;
+
+public:
+  numa_allocator() noexcept = default;
+
+  explicit numa_allocator(
+   std::uint32_t capacity,
+   std::uint32_t node_cnt = vm_numa_node_cnt()):
+   base(capacity, node_cnt, backing::reserve) {
+    auto page = vm_page_size();
+    for (std::uint32_t s = 0; s < this->shard_cnt(); ++s) {
+      auto first = this->shard_begin(s), last = this->shard_begin(s + 1);
+      if (first == last) continue;
+      auto b = (std::uintptr_t)&this->deref(first) / page * page;
+      auto e = (std::uintptr_t)(&this->deref(last - 1) + 1);
+      bound = vm_bind((void*)b, e - b, s) && bound;
+    }
+  }
+
+  bool is_bound() const noexcept {
+    return bound;
+  }
+
+private:
+  bool bound{true};
+};
+
+#include "epilog.inc"
+
+#endif // LF_NUMA_ALLOCATOR_HPP
@@ -0,0 +1,133 @@
+#ifndef LF_POOL_RESOURCE_HPP
+#define LF_POOL_RESOURCE_HPP
+
+#include "allocator.hpp"
+
+#include <cstddef>
+
+// Older standard libraries, e.g., libstdc++ before gcc 9 and libc++
+// before clang 16, do not ship <memory_resource>.
+#if __has_include(<memory_resource>)
+  #define LF_HAS_MEMORY_RESOURCE 1
+  #include <memory_resource>
+#endif
+
+#ifdef LF_HAS_MEMORY_RESOURCE
+
+#include "prolog.inc"
+
+// Serves blocks of up to `BlockSize` bytes aligned to at most `Align`
+// from a lock-free pool. Other requests, and requests made while
+// the pool is exhausted, go to the upstream resource.
+template <
+ std::size_t BlockSize,
+ std::size_t Align = alignof(std::max_align_t)>
+class pool_resource final: public std::pmr::memory_resource {
+  static_assert(BlockSize > 0);
+
+public:
+  explicit pool_resource(
+   std::uint32_t capacity,
+   std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+   backing bk = backing::heap):
+   alloc(capacity, bk),
+   upstream(upstream) {
+    // nop
+  }
+
+  pool_resource(const pool_resource&) = delete;
+  pool_resource& operator=(const pool_resource&) = delete;
+
+  std::pmr::memory_resource* upstream_resource() const noexcept {
+    return upstream;
+  }
+
+  bool owns(const void* p) const noexcept {
+    auto cap = alloc.capacity();
+    if (!cap) return false;
+    auto first = (std::uintptr_t)&alloc.deref(0);
+    auto addr = (std::uintptr_t)p;
+    return first <= addr && addr < first + sizeof(node) * cap;
+  }
+
+private:
+  struct alignas(Align) block {
+    unsigned char buf[BlockSize];
+  };
+
+  using node = typename allocator<block>::node;
+
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    if (bytes <= BlockSize && align <= Align) {
+      auto p = alloc.try_allocate();
+      if (p != null) return &alloc.deref(p).val;
+    }
+    return upstream->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+    if (owns(p)) alloc.deallocate(std::uint32_t((node*)p - &alloc.deref(0)));
+    else upstream->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  mutable allocator<block> alloc;
+  std::pmr::memory_resource* upstream;
+};
+
+// Allocator-concept wrapper over a memory resource.
+// With a final `Resource` such as `pool_resource`, calls can be devirtualized.
+template <typename T, typename Resource = std::pmr::memory_resource>
+class pool_allocator {
+public:
+  using value_type = T;
+
+  pool_allocator(Resource& res) noexcept:
+   res(&res) {
+    // nop
+  }
+
+  template <typename U>
+  pool_allocator(const pool_allocator<U, Resource>& other) noexcept:
+   res(other.resource()) {
+    // nop
+  }
+
+  T* allocate(std::size_t n) {
+    return (T*)res->allocate(sizeof(T) * n, alignof(T));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    res->deallocate(p, sizeof(T) * n, alignof(T));
+  }
+
+  Resource* resource() const noexcept {
+    return res;
+  }
+
+private:
+  Resource* res;
+};
+
+template <typename T, typename U, typename Resource>
+bool operator==(
+ const pool_allocator<T, Resource>& a,
+ const pool_allocator<U, Resource>& b) noexcept {
+  return a.resource() == b.resource();
+}
+
+template <typename T, typename U, typename Resource>
+bool operator!=(
+ const pool_allocator<T, Resource>& a,
+ const pool_allocator<U, Resource>& b) noexcept {
+  return !(a == b);
+}
+
+#include "epilog.inc"
+
+#endif // LF_HAS_MEMORY_RESOURCE
+
+#endif // LF_POOL_RESOURCE_HPP
@@ -0,0 +1,116 @@
+#ifndef LF_SHARDED_ALLOCATOR_HPP
+#define LF_SHARDED_ALLOCATOR_HPP
+
+#include "allocator.hpp"
+
+#include <memory>
+#include <thread>
+
+#include "prolog.inc"
+
+struct thread_home {
+  std::uint32_t operator()(std::uint32_t shard_cnt) const noexcept {
+    return thread_index() % shard_cnt;
+  }
+};
+
+// Nodes live in one array, partitioned into contiguous shards,
+// each with its own free list and bump frontier.
+// A thread allocates from its home shard and steals from the following
+// shards only when that is empty. Nodes return to the shard owning them.
+template <typename T, typename Home = thread_home>
+class sharded_allocator {
+public:
+  using node = typename allocator<T>::node;
+
+  sharded_allocator() noexcept = default;
+
+  explicit sharded_allocator(
+   std::uint32_t capacity,
+   std::uint32_t shard_cnt = default_shard_cnt(),
+   backing bk = backing::heap):
+   nodes(capacity, bk),
+   cnt(shard_cnt ? shard_cnt : 1),
+   stride(std::max(capacity / cnt + (capacity % cnt != 0), 1u)),
+   shards(std::make_unique<shard[]>(cnt)) {
+    for (std::uint32_t s = 0; s < cnt; ++s) {
+      shards[s].fr.rewind(nodes, shard_begin(s), shard_begin(s + 1));
+    }
+  }
+
+  sharded_allocator(const sharded_allocator&) = delete;
+  sharded_allocator& operator=(const sharded_allocator&) = delete;
+
+  static std::uint32_t default_shard_cnt() noexcept {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  std::uint32_t shard_cnt() const noexcept {
+    return cnt;
+  }
+
+  std::uint32_t capacity() const noexcept {
+    return nodes.capacity();
+  }
+
+  backing get_backing() const noexcept {
+    return nodes.get_backing();
+  }
+
+  std::uint32_t home() const noexcept {
+    return Home{}(cnt);
+  }
+
+  std::uint32_t owner(std::uint32_t p) const noexcept {
+    return p / stride;
+  }
+
+  std::uint32_t shard_begin(std::uint32_t s) const noexcept {
+    return (std::uint32_t)std::min<std::uint64_t>(
+      std::uint64_t(stride) * s, nodes.capacity());
+  }
+
+  std::uint32_t try_allocate() noexcept {
+    return cnt ? try_allocate(home()) : null;
+  }
+
+  std::uint32_t try_allocate(std::uint32_t home) noexcept {
+    auto s = home;
+    for (std::uint32_t i = 0; i < cnt; ++i) {
+      auto& sh = shards[s];
+      auto p = impl::pop(sh.head, *this);
+      if (p != null || sh.fr.try_bump(nodes, 1, p)) return p;
+      if (++s == cnt) s = 0;
+    }
+    return null;
+  }
+
+  void deallocate(std::uint32_t p) noexcept {
+    impl::push(shards[owner(p)].head, *this, p, p);
+  }
+
+  node& deref(std::uint32_t ptr) noexcept {
+    return nodes.data()[ptr];
+  }
+
+  void del(std::uint32_t p) noexcept {
+    auto& nod = deref(p);
+    uninit(&nod.val);
+    deallocate(p);
+  }
+
+private:
+  struct alignas(cache_line) shard {
+    std::atomic<cp_t> head{cp_t{}};
+    impl::frontier<> fr;
+  };
+
+  impl::arena<node> nodes;
+  std::uint32_t cnt{};
+  std::uint32_t stride{1};
+  std::unique_ptr<shard[]> shards;
+};
+
+#include "epilog.inc"
+
+#endif // LF_SHARDED_ALLOCATOR_HPP
@@ -0,0 +1,128 @@
+#ifndef LF_SLAB_HPP
+#define LF_SLAB_HPP
+
+#include "soa_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <utility>
+
+#include "prolog.inc"
+
+// Variable-size allocation over power-of-two size classes
+// from `MinSize` to `MaxSize` bytes, each a lock-free pool of its own.
+// Links are kept apart from blocks, so blocks are packed without overhead.
+template <std::size_t MinSize = 16, std::size_t MaxSize = 4096>
+class slab {
+  static_assert(MinSize && (MinSize & (MinSize - 1)) == 0);
+  static_assert(MaxSize >= MinSize && (MaxSize & (MaxSize - 1)) == 0);
+
+public:
+  static constexpr unsigned class_cnt = ilog2(MaxSize) - ilog2(MinSize) + 1;
+
+  static constexpr unsigned size_class(std::size_t bytes) noexcept {
+    return bytes <= MinSize ? 0 : ilog2(bytes - 1) + 1 - ilog2(MinSize);
+  }
+
+  static constexpr std::size_t class_size(unsigned k) noexcept {
+    return MinSize << k;
+  }
+
+  slab() noexcept = default;
+
+  // Gives every class `capacity` blocks.
+  explicit slab(std::uint32_t capacity):
+   slab(capacity, std::make_index_sequence<class_cnt>{}) {
+    // nop
+  }
+
+  // Gives class `k` `capacities[k]` blocks,
+  // so that large classes need not reserve as many blocks as small ones.
+  explicit slab(const std::uint32_t (&capacities)[class_cnt]):
+   slab(capacities, std::make_index_sequence<class_cnt>{}) {
+    // nop
+  }
+
+  slab(const slab&) = delete;
+  slab& operator=(const slab&) = delete;
+
+  // Returns `nullptr` if `bytes` exceeds `MaxSize` or its class is exhausted.
+  void* try_allocate(std::size_t bytes) noexcept {
+    if (bytes > MaxSize) return nullptr;
+    return try_allocate(size_class(bytes), seq{});
+  }
+
+  void* allocate(std::size_t bytes) {
+    auto p = try_allocate(bytes);
+    if (!p) throw std::bad_alloc();
+    return p;
+  }
+
+  // `bytes` must be the size passed to allocation,
+  // hence no larger than `MaxSize`.
+  void deallocate(void* p, std::size_t bytes) noexcept {
+    assert(bytes <= MaxSize);
+    deallocate(p, size_class(bytes), seq{});
+  }
+
+private:
+  using seq = std::make_index_sequence<class_cnt>;
+
+  template <std::size_t Size>
+  struct block {
+    alignas(std::min(Size, alignof(std::max_align_t))) unsigned char buf[Size];
+  };
+
+  template <std::size_t... I>
+  static auto make_pools(std::index_sequence<I...>) ->
+   std::tuple<soa_allocator<block<(MinSize << I)>>...>;
+
+  template <std::size_t... I>
+  slab(std::uint32_t capacity, std::index_sequence<I...>):
+   pools(((void)I, capacity)...) {
+    // nop
+  }
+
+  template <std::size_t... I>
+  slab(
+   const std::uint32_t (&capacities)[class_cnt],
+   std::index_sequence<I...>):
+   pools(capacities[I]...) {
+    // nop
+  }
+
+  template <std::size_t K>
+  void* try_take() noexcept {
+    auto& pool = std::get<K>(pools);
+    auto p = pool.try_allocate();
+    return p != null ? pool.deref(p).val.buf : nullptr;
+  }
+
+  template <std::size_t K>
+  void give_back(void* p) noexcept {
+    auto& pool = std::get<K>(pools);
+    using block_t = std::remove_reference_t<decltype(pool.deref(0).val)>;
+    pool.deallocate(std::uint32_t((block_t*)p - &pool.deref(0).val));
+  }
+
+  template <std::size_t... I>
+  void* try_allocate(unsigned k, std::index_sequence<I...>) noexcept {
+    void* p = nullptr;
+    (void)((k == I && (p = try_take<I>(), true)) || ...);
+    return p;
+  }
+
+  template <std::size_t... I>
+  void deallocate(void* p, unsigned k, std::index_sequence<I...>) noexcept {
+    (void)((k == I && (give_back<I>(p), true)) || ...);
+  }
+
+  decltype(make_pools(seq{})) pools;
+};
+
+#include "epilog.inc"
+
+#endif // LF_SLAB_HPP
@@ -0,0 +1,90 @@
+#ifndef LF_SOA_ALLOCATOR_HPP
+#define LF_SOA_ALLOCATOR_HPP
+
+#include "allocator.hpp"
+
+#include "prolog.inc"
+
+// Keeps links and values in separate arrays,
+// so that free list operations only touch the dense link array.
+// `deref()` returns a pair of references instead of a node reference.
+template <typename T>
+class soa_allocator {
+public:
+  struct node {
+    T& val;
+    std::atomic_uint32_t& next;
+  };
+
+  soa_allocator() noexcept = default;
+
+  explicit soa_allocator(std::uint32_t capacity):
+   links(capacity, backing::heap),
+   vals(capacity, backing::heap) {
+    fr.rewind(links, 0, capacity);
+  }
+
+  soa_allocator(const soa_allocator&) = delete;
+  soa_allocator& operator=(const soa_allocator&) = delete;
+
+  void reset(std::uint32_t capacity) {
+    reset(capacity, []() noexcept {});
+  }
+
+  template <typename F, typename... Args>
+  void reset(std::uint32_t capacity, F&& f, Args&&... args) {
+    impl::arena<link> newlinks(capacity, backing::heap);
+    impl::arena<T> newvals(capacity, backing::heap);
+    std::invoke(std::forward<F>(f), std::forward<Args>(args)...);
+    links.swap(newlinks);
+    vals.swap(newvals);
+    head.store({}, rlx);
+    fr.rewind(links, 0, capacity);
+  }
+
+  std::uint32_t try_allocate() noexcept {
+    auto p = impl::pop(head, *this);
+    return p != null ? p : fr.try_bump(links, 1, p) ? p : null;
+  }
+
+  std::uint32_t try_allocate_n(std::uint32_t n, std::uint32_t& out) noexcept {
+    auto cnt = impl::pop_n(head, *this, n, out);
+    return cnt ? cnt : fr.try_bump(links, n, out);
+  }
+
+  void deallocate(std::uint32_t p) noexcept {
+    impl::push(head, *this, p, p);
+  }
+
+  void deallocate_chain(
+   std::uint32_t first, std::uint32_t last, std::uint32_t /*n*/) noexcept {
+    impl::push(head, *this, first, last);
+  }
+
+  node deref(std::uint32_t ptr) noexcept {
+    return {vals.data()[ptr], links.data()[ptr].next};
+  }
+
+  void del(std::uint32_t p) noexcept {
+    uninit(&vals.data()[p]);
+    deallocate(p);
+  }
+
+  std::uint32_t capacity() const noexcept {
+    return links.capacity();
+  }
+
+private:
+  struct link {
+    std::atomic_uint32_t next;
+  };
+
+  impl::arena<link> links;
+  impl::arena<T> vals;
+  impl::frontier<> fr;
+  std::atomic<cp_t> head{cp_t{}};
+};
+
+#include "epilog.inc"
+
+#endif // LF_SOA_ALLOCATOR_HPP
@@ -2,20 +2,253 @@
 #define LF_STACK_HPP
 
 #include "allocator.hpp"
+#include "futex.hpp"
 
+#include <chrono>
+#include <functional>
+#include <iterator>
 #include <optional>
+#include <utility>
 
 #include "prolog.inc"
 
 template <typename T>
-class stack {
+class mapped_stack;
+
+namespace impl {
+
+// Elimination array. A push that fails on the head may offer its node
+// in a random slot for a while, and a pop that fails may take it,
+// so that both complete without touching the head.
+template <std::uint32_t Slots, typename Cp>
+class exchanger {
+public:
+  using index_type = typename Cp::index_type;
+
+  static constexpr unsigned spins = 64;
+
+  exchanger() noexcept {
+    for (auto& s : slots) {
+      s.store(Cp{}, rlx);
+    }
+  }
+
+  bool try_offer(index_type p) noexcept {
+    auto& s = pick();
+    auto cur = s.load(rlx);
+    if (cur.ptr != Cp::null) return false;
+    Cp offer;
+    offer.ptr = p;
+    offer.cnt = cur.cnt + 1;
+    if (!s.compare_exchange_strong(cur, offer, rel, rlx)) return false;
+    for (auto i = spins; i; --i) {
+      if (s.load(rlx).cnt != offer.cnt) return true;
+      cpu_relax();
+    }
+    Cp withdrawn;
+    withdrawn.cnt = offer.cnt + 1;
+    return !s.compare_exchange_strong(offer, withdrawn, rlx, rlx);
+  }
+
+  index_type try_take() noexcept {
+    auto& s = pick();
+    auto cur = s.load(rlx);
+    if (cur.ptr == Cp::null) return Cp::null;
+    Cp taken;
+    taken.cnt = cur.cnt + 1;
+    return s.compare_exchange_strong(cur, taken, acq, rlx) ? cur.ptr : Cp::null;
+  }
+
+private:
+  std::atomic<Cp>& pick() noexcept {
+    return slots[thread_random() % Slots];
+  }
+
+  aligned<std::atomic<Cp>, cache_line> slots[Slots];
+};
+
+template <typename Cp>
+class exchanger<0, Cp> {
+public:
+  using index_type = typename Cp::index_type;
+
+  bool try_offer(index_type) noexcept {
+    return false;
+  }
+
+  index_type try_take() noexcept {
+    return Cp::null;
+  }
+};
+
+// Parks poppers of a waitable stack until a push.
+// Other stacks get the no-op specialization, which adds no space.
+template <bool Waitable>
+class pop_waiters {
+public:
+  template <typename F>
+  bool await_nonempty(
+   F&& f, std::chrono::steady_clock::time_point deadline) noexcept {
+    return nonempty.await(std::forward<F>(f), deadline);
+  }
+
+  void notify_nonempty(int n) noexcept {
+    nonempty.notify(n);
+  }
+
+  void clear_waiters() noexcept {
+    nonempty.clear();
+  }
+
+private:
+  event_count nonempty;
+};
+
+template <>
+class pop_waiters<false> {
+public:
+  void notify_nonempty(int) noexcept {}
+  void clear_waiters() noexcept {}
+};
+
+template <typename Alloc, typename = void>
+struct has_deallocate_chain: std::false_type {};
+
+template <typename Alloc>
+struct has_deallocate_chain<Alloc, std::void_t<decltype(
+ std::declval<Alloc&>().deallocate_chain(
+  typename cp_of_t<Alloc>::index_type{},
+  typename cp_of_t<Alloc>::index_type{},
+  typename cp_of_t<Alloc>::index_type{}))>>: std::true_type {};
+
+template <typename Alloc>
+inline constexpr bool has_deallocate_chain_v =
+ has_deallocate_chain<Alloc>::value;
+
+} // namespace impl
+
+// `Alloc` may be a reference, letting many stacks share one node pool.
+// A stack then returns its remaining nodes to the pool on destruction.
+// `Backoff` is applied to failed CAS on the head,
+// and defaults to the one of the allocator.
+// `Slots` sizes the elimination array. Zero disables elimination.
+// `Waitable` enables `wait_pop()`, at the cost of 8 bytes and a load
+// per push. See `waitable_stack`.
+template <
+ typename T,
+ typename Alloc = allocator<T>,
+ typename Backoff = impl::backoff_of_t<std::remove_reference_t<Alloc>>,
+ std::uint32_t Slots = 0,
+ bool Waitable = false>
+class stack:
+ private impl::exchanger<Slots, impl::cp_of_t<std::remove_reference_t<Alloc>>>,
+ private impl::pop_waiters<Waitable> {
   static_assert(std::is_move_constructible_v<T>);
 
+  using alloc_type = std::remove_reference_t<Alloc>;
+  using cp_type = impl::cp_of_t<alloc_type>;
+  static_assert(std::atomic<cp_type>::is_always_lock_free);
+
 public:
+  using index_type = typename cp_type::index_type;
+
+  // Nodes detached by `pop_all()`, top first.
+  // Each node is returned to the allocator as iteration moves past it,
+  // and the remaining ones on destruction.
+  class batch {
+  public:
+    struct sentinel {};
+
+    class iterator {
+    public:
+      T& operator*() const noexcept {
+        return b->alloc->deref(b->p).val;
+      }
+
+      T* operator->() const noexcept {
+        return &**this;
+      }
+
+      iterator& operator++() noexcept {
+        b->pop_front();
+        return *this;
+      }
+
+      bool operator==(sentinel) const noexcept {
+        return b->empty();
+      }
+
+      bool operator!=(sentinel) const noexcept {
+        return !b->empty();
+      }
+
+    private:
+      friend class batch;
+
+      explicit iterator(batch* b) noexcept:
+       b(b) {
+        // nop
+      }
+
+      batch* b;
+    };
+
+    batch(batch&& b) noexcept:
+     alloc(b.alloc),
+     p(std::exchange(b.p, cp_type::null)) {
+      // nop
+    }
+
+    ~batch() {
+      while (!empty()) pop_front();
+    }
+
+    batch& operator=(batch&&) = delete;
+
+    bool empty() const noexcept {
+      return p == cp_type::null;
+    }
+
+    iterator begin() noexcept {
+      return iterator(this);
+    }
+
+    sentinel end() const noexcept {
+      return {};
+    }
+
+  private:
+    friend class stack;
+
+    batch(alloc_type* alloc, index_type p) noexcept:
+     alloc(alloc),
+     p(p) {
+      // nop
+    }
+
+    void pop_front() noexcept {
+      auto next = alloc->deref(p).next.load(rlx);
+      alloc->del(p);
+      p = next;
+    }
+
+    alloc_type* alloc;
+    index_type p;
+  };
+
   stack() noexcept = default;
 
-  explicit stack(std::uint32_t capacity):
-   alloc(capacity) {
+  template <typename... Args>
+  explicit stack(index_type capacity, Args&&... args):
+   alloc(capacity, std::forward<Args>(args)...) {
+    // nop
+  }
+
+  template <
+   typename A = Alloc,
+   typename = std::enable_if_t<std::is_reference_v<A>>>
+  explicit stack(alloc_type& alloc) noexcept:
+   alloc(alloc) {
     // nop
   }
 
@@ -26,56 +259,251 @@ public:
   stack(const stack&) = delete;
   stack& operator=(const stack&) = delete;
 
-  void reset(std::uint32_t capacity) {
+  void reset(index_type capacity) {
+    static_assert(!std::is_reference_v<Alloc>, "Cannot reset a shared pool.");
     alloc.reset(capacity, &stack::uninit, this);
     head.store({}, rlx);
   }
 
   bool try_push(T&& v) noexcept {
     auto p = alloc.try_allocate();
-    if (p == null) return false;
-    auto& nod = alloc.deref(p);
-    init(&nod.val, std::move(v));
-    cp_t newhd{p}, oldhd(head.load(rlx));
-    do {
-      nod.next.store(oldhd.ptr, rlx);
+    if (p == cp_type::null) return false;
+    init(&alloc.deref(p).val, std::move(v));
+    publish(p);
+    return true;
+  }
+
+  bool try_push(const T& v) {
+    return try_emplace(v);
+  }
+
+  // Spins briefly, then blocks until the allocator has a free node,
+  // giving producers backpressure from a bounded pool.
+  // Requires an allocator with `wait_allocate()` and `wait_allocate_for()`.
+  void wait_push(T&& v) noexcept {
+    auto p = alloc.wait_allocate();
+    init(&alloc.deref(p).val, std::move(v));
+    publish(p);
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_push_for(
+   T&& v, std::chrono::duration<Rep, Period> timeout) noexcept {
+    auto p = alloc.wait_allocate_for(timeout);
+    if (p == cp_type::null) return false;
+    init(&alloc.deref(p).val, std::move(v));
+    publish(p);
+    return true;
+  }
+
+  // Constructs the element in place, with parentheses if viable,
+  // or braces otherwise, e.g., for aggregates.
+  template <typename... Args>
+  bool try_emplace(Args&&... args) {
+    auto p = alloc.try_allocate();
+    if (p == cp_type::null) return false;
+    try {
+      init(&alloc.deref(p).val, std::forward<Args>(args)...);
+    }
+    catch (...) {
+      alloc.deallocate(p);
+      throw;
+    }
+    publish(p);
+    return true;
+  }
+
+  // Pushes all or none of the elements, as if pushed one by one in order,
+  // publishing them with a single CAS on success.
+  // Requires forward iterators and an allocator with `try_allocate_n()`.
+  template <typename It>
+  bool try_push_range(It first, It last) {
+    auto n = index_type(std::distance(first, last));
+    if (!n) return true;
+    index_type bottom, top, got = 0;
+    while (got < n) {
+      index_type out;
+      auto cnt = alloc.try_allocate_n(n - got, out);
+      if (!cnt) {
+        if (got) alloc.deallocate_chain(bottom, top, got);
+        return false;
+      }
+      if (got) alloc.deref(top).next.store(out, rlx);
+      else bottom = out;
+      got += cnt;
+      top = out;
+      while (--cnt) top = alloc.deref(top).next.load(rlx);
+    }
+    // Links the chain the other way round while filling it in,
+    // so that the last element ends up on top.
+    auto p = bottom, prev = cp_type::null;
+    index_type k = 0;
+    try {
+      for (; first != last; ++first, ++k) {
+        auto&& nod = alloc.deref(p);
+        auto next = nod.next.load(rlx);
+        init(&nod.val, *first);
+        nod.next.store(prev, rlx);
+        prev = p;
+        p = next;
+      }
+    }
+    catch (...) {
+      while (prev != cp_type::null) {
+        auto next = alloc.deref(prev).next.load(rlx);
+        alloc.del(prev);
+        prev = next;
+      }
+      alloc.deallocate_chain(p, top, n - k);
+      throw;
+    }
+    auto&& btm = alloc.deref(bottom);
+    cp_type newhd{top}, oldhd(head.load(rlx));
+    for (Backoff backoff;; backoff()) {
+      btm.next.store(oldhd.ptr, rlx);
       newhd.cnt = oldhd.cnt;
+      if (head.compare_exchange_weak(oldhd, newhd, cst, rlx)) break;
     }
-    while (!head.compare_exchange_weak(oldhd, newhd, rel, rlx));
+    this->notify_nonempty(n < INT_MAX ? int(n) : INT_MAX);
     return true;
   }
 
   std::optional<T> try_pop() noexcept {
-    cp_t newhd, oldhd(head.load(acq));
-    node* p;
-    do {
-      if (oldhd.ptr == null) return {};
-      p = &alloc.deref(oldhd.ptr);
-      newhd.ptr = p->next.load(rlx);
+    auto p = take();
+    if (p == cp_type::null) return {};
+    return extract(p);
+  }
+
+  bool try_pop(T& out) noexcept(std::is_nothrow_move_assignable_v<T>) {
+    return try_pop_with([&out](T& v) { out = std::move(v); });
+  }
+
+  // Spins briefly, then blocks until an element is available.
+  T wait_pop() noexcept {
+    index_type p;
+    auto taken = [this, &p]() noexcept {
+      return (p = take()) != cp_type::null;
+    };
+    static_assert(Waitable, "Use waitable_stack.");
+    this->await_nonempty(taken, std::chrono::steady_clock::time_point::max());
+    return extract(p);
+  }
+
+  template <typename Rep, typename Period>
+  std::optional<T> wait_pop_for(
+   std::chrono::duration<Rep, Period> timeout) noexcept {
+    index_type p;
+    auto taken = [this, &p]() noexcept {
+      return (p = take()) != cp_type::null;
+    };
+    static_assert(Waitable, "Use waitable_stack.");
+    if (!this->await_nonempty(taken, impl::deadline_after(timeout))) return {};
+    return extract(p);
+  }
+
+  // Invokes `f` on the popped element in place,
+  // before its node is returned to the allocator.
+  template <typename F>
+  bool try_pop_with(F&& f) noexcept(std::is_nothrow_invocable_v<F, T&>) {
+    auto p = take();
+    if (p == cp_type::null) return false;
+    auto& val = alloc.deref(p).val;
+    try {
+      std::invoke(std::forward<F>(f), val);
+    }
+    catch (...) {
+      alloc.del(p);
+      throw;
+    }
+    alloc.del(p);
+    return true;
+  }
+
+  // Detaches all elements at once.
+  batch pop_all() noexcept {
+    cp_type newhd, oldhd(head.load(acq));
+    for (Backoff backoff;; backoff()) {
+      if (oldhd.ptr == cp_type::null) break;
       newhd.cnt = oldhd.cnt + 1;
+      if (head.compare_exchange_weak(oldhd, newhd, acq, acq)) break;
     }
-    while (!head.compare_exchange_weak(oldhd, newhd, rlx, acq));
-    auto res = std::make_optional(std::move(p->val));
-    alloc.del(oldhd.ptr);
-    return res;
+    return batch(&alloc, oldhd.ptr);
   }
 
 private:
-  using node = typename allocator<T>::node;
+  template <typename>
+  friend class mapped_stack;
 
+  using layout_type = impl::layout_of_t<alloc_type>;
+
+  T extract(index_type p) noexcept {
+    T res(std::move(alloc.deref(p).val));
+    alloc.del(p);
+    return res;
+  }
+
+  index_type take() noexcept {
+    cp_type newhd, oldhd(head.load(acq));
+    for (Backoff backoff;; backoff()) {
+      if (oldhd.ptr == cp_type::null) return cp_type::null;
+      newhd.ptr = alloc.deref(oldhd.ptr).next.load(rlx);
+      newhd.cnt = oldhd.cnt + 1;
+      if (head.compare_exchange_weak(oldhd, newhd, acq, acq)) return oldhd.ptr;
+      if (auto p = this->try_take(); p != cp_type::null) return p;
+    }
+  }
+
+  void publish(index_type p) noexcept {
+    auto&& nod = alloc.deref(p);
+    cp_type newhd{p}, oldhd(head.load(rlx));
+    for (Backoff backoff;; backoff()) {
+      nod.next.store(oldhd.ptr, rlx);
+      newhd.cnt = oldhd.cnt;
+      if (head.compare_exchange_weak(oldhd, newhd, cst, rlx)) break;
+      if (this->try_offer(p)) break;
+    }
+    this->notify_nonempty(1);
+  }
+
+  // A shared pool gets the nodes back as one chain,
+  // so that tearing down a stack costs one CAS on its head.
   void uninit() noexcept {
-    auto p = head.load(rlx).ptr;
-    while (p != null) {
-      auto& nod = alloc.deref(p);
+    auto first = head.load(rlx).ptr;
+    auto last = first;
+    index_type n = 0;
+    for (auto p = first; p != cp_type::null; ++n) {
+      auto&& nod = alloc.deref(p);
       lf::uninit(&nod.val);
+      last = p;
       p = nod.next.load(rlx);
     }
+    // An owned pool goes away with the stack.
+    if constexpr (std::is_reference_v<Alloc>) {
+      if constexpr (impl::has_deallocate_chain_v<alloc_type>) {
+        if (n) alloc.deallocate_chain(first, last, n);
+      }
+      else {
+        for (auto p = first; p != cp_type::null;) {
+          auto next = alloc.deref(p).next.load(rlx);
+          alloc.deallocate(p);
+          p = next;
+        }
+      }
+    }
   }
 
-  allocator<T> alloc;
-  std::atomic<cp_t> head{cp_t{}};
+  Alloc alloc;
+  impl::aligned<std::atomic<cp_type>, layout_type::head_align> head{cp_type{}};
 };
 
+// Stack whose `wait_pop()` and `wait_pop_for()` block on empty.
+template <
+ typename T,
+ typename Alloc = allocator<T>,
+ typename Backoff = impl::backoff_of_t<std::remove_reference_t<Alloc>>,
+ std::uint32_t Slots = 0>
+using waitable_stack = stack<T, Alloc, Backoff, Slots, true>;
+
 #include "epilog.inc"
 
 #endif // LF_STACK_HPP
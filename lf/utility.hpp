@@ -1,8 +1,10 @@
 #ifndef LF_UTILITY_HPP
 #define LF_UTILITY_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <atomic>
+#include <type_traits>
 
 #include "prolog.inc"
 
@@ -15,11 +17,68 @@ inline constexpr auto acq_rel = std::memory_order_acq_rel;
 
 inline constexpr auto null = std::uint32_t(-1);
 
-struct cp_t {
+inline constexpr std::size_t cache_line = 64;
+
+inline
+std::uint32_t thread_index() noexcept {
+  static std::atomic_uint32_t cnt{};
+  thread_local const auto idx = cnt.fetch_add(1, rlx);
+  return idx;
+}
+
+// Cheap per-thread pseudo random numbers, e.g., to spread threads over slots.
+inline
+std::uint32_t thread_random() noexcept {
+  thread_local auto x = thread_index() * 2654435761u + 1;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+constexpr unsigned ilog2(std::uint64_t v) noexcept {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(v);
+#else
+  unsigned r = 0;
+  while (v >>= 1) ++r;
+  return r;
+#endif
+}
+
+// Counted pointer packing an `IdxBits` wide index and an ABA counter
+// taking the remaining bits of a 64-bit word.
+template <unsigned IdxBits>
+struct basic_cp {
+  static_assert(0 < IdxBits && IdxBits < 64);
+
+  using index_type = std::conditional_t<
+   (IdxBits <= 32), std::uint32_t, std::uint64_t>;
+
+  static constexpr auto null = index_type((std::uint64_t(1) << IdxBits) - 1);
+
+  constexpr basic_cp(std::uint64_t ptr = null, std::uint64_t cnt = 0) noexcept:
+   ptr(ptr),
+   cnt(cnt) {
+    // nop
+  }
+
+  std::uint64_t ptr : IdxBits;
+  std::uint64_t cnt : 64 - IdxBits;
+};
+
+template <>
+struct basic_cp<32> {
+  using index_type = std::uint32_t;
+
+  static constexpr auto null = lf::null;
+
   std::uint32_t ptr{null};
   std::uint32_t cnt{};
 };
 
+using cp_t = basic_cp<32>;
+
 static_assert(std::atomic<cp_t>::is_always_lock_free);
 
 #include "epilog.inc"
@@ -0,0 +1,173 @@
+#ifndef LF_VMEM_HPP
+#define LF_VMEM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define LF_HAS_VMEM 1
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+  #include <sys/syscall.h>
+#endif
+
+#include "prolog.inc"
+
+inline
+std::size_t vm_page_size() noexcept {
+#ifdef LF_HAS_VMEM
+  static const auto sz = (std::size_t)sysconf(_SC_PAGESIZE);
+  return sz;
+#else
+  return 4096;
+#endif
+}
+
+constexpr
+std::size_t vm_round_up(std::size_t bytes, std::size_t align) noexcept {
+  return (bytes + align - 1) / align * align;
+}
+
+inline
+bool vm_commit(void* p, std::size_t bytes) noexcept {
+#ifdef LF_HAS_VMEM
+  return mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0;
+#else
+  (void)p;
+  (void)bytes;
+  return false;
+#endif
+}
+
+inline
+void vm_release(void* p, std::size_t bytes) noexcept {
+#ifdef LF_HAS_VMEM
+  if (p) munmap(p, bytes);
+#else
+  (void)p;
+  (void)bytes;
+#endif
+}
+
+inline constexpr std::size_t vm_huge_page_size = std::size_t(1) << 21;
+
+namespace impl {
+
+// Huge TLB mappings are left reserving, so that a short huge page pool
+// fails here rather than with SIGBUS on first touch.
+inline
+void* vm_map(std::size_t bytes, int extra_flags) noexcept {
+#ifdef LF_HAS_VMEM
+  auto flags = MAP_PRIVATE | MAP_ANON | extra_flags;
+  #ifdef MAP_NORESERVE
+  if (!extra_flags) flags |= MAP_NORESERVE;
+  #endif
+  auto p = mmap(nullptr, bytes, PROT_NONE, flags, -1, 0);
+  return p == MAP_FAILED ? nullptr : p;
+#else
+  (void)bytes;
+  (void)extra_flags;
+  return nullptr;
+#endif
+}
+
+} // namespace impl
+
+// Reserves address space without committing memory.
+// Returns nullptr on failure.
+inline
+void* vm_reserve(std::size_t bytes) noexcept {
+  return impl::vm_map(bytes, 0);
+}
+
+// Same as above, with the start aligned to `align`.
+inline
+void* vm_reserve(std::size_t bytes, std::size_t align) noexcept {
+  auto p = (char*)impl::vm_map(bytes + align, 0);
+  if (!p) return nullptr;
+  auto a = (char*)vm_round_up((std::uintptr_t)p, align);
+  if (a != p) vm_release(p, a - p);
+  if (a != p + align) vm_release(a + bytes, p + align - a);
+  return a;
+}
+
+// Reserves address space backed by explicit huge pages (MAP_HUGETLB).
+// `bytes` should be a multiple of vm_huge_page_size.
+inline
+void* vm_reserve_huge(std::size_t bytes) noexcept {
+#ifdef MAP_HUGETLB
+  return impl::vm_map(bytes, MAP_HUGETLB);
+#else
+  (void)bytes;
+  return nullptr;
+#endif
+}
+
+// Asks for transparent huge pages in the range.
+inline
+bool vm_advise_huge(void* p, std::size_t bytes) noexcept {
+#ifdef MADV_HUGEPAGE
+  return madvise(p, bytes, MADV_HUGEPAGE) == 0;
+#else
+  (void)p;
+  (void)bytes;
+  return false;
+#endif
+}
+
+inline
+std::uint32_t vm_numa_node_cnt() noexcept {
+  std::uint32_t cnt = 1;
+#if defined(__linux__)
+  if (auto f = std::fopen("/sys/devices/system/node/online", "r")) {
+    unsigned a, b;
+    while (std::fscanf(f, "%u", &a) == 1) {
+      b = a;
+      auto c = std::fgetc(f);
+      if (c == '-' && std::fscanf(f, "%u", &b) == 1) c = std::fgetc(f);
+      cnt = std::max(cnt, b + 1);
+      if (c != ',') break;
+    }
+    std::fclose(f);
+  }
+#endif
+  return cnt;
+}
+
+// NUMA node of the CPU the calling thread currently runs on.
+inline
+std::uint32_t vm_numa_node() noexcept {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+  return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? node : 0;
+#else
+  return 0;
+#endif
+}
+
+// Asks that pages in the range be placed on `node` when first touched.
+// Returns false if NUMA placement is unavailable.
+inline
+bool vm_bind(void* p, std::size_t bytes, std::uint32_t node) noexcept {
+#if defined(__linux__) && defined(SYS_mbind)
+  constexpr unsigned long preferred = 1, bits = 8 * sizeof(unsigned long);
+  unsigned long mask[16]{};
+  if (node >= 16 * bits - 1) return false;
+  mask[node / bits] = 1ul << (node % bits);
+  return syscall(SYS_mbind, p, bytes, preferred, mask, 16 * bits, 0ul) == 0;
+#else
+  (void)p;
+  (void)bytes;
+  (void)node;
+  return false;
+#endif
+}
+
+#include "epilog.inc"
+
+#endif // LF_VMEM_HPP
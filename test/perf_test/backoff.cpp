@@ -0,0 +1,53 @@
+#include "cli.hpp"
+#include "simulator2.hpp"
+
+#include <lf/stack.hpp>
+
+enum struct policy {
+  none,
+  exp,
+  adaptive
+};
+
+std::istream& operator>>(std::istream& is, policy& tag) {
+  std::string s;
+  if (is >> s) {
+    if (s == "none") tag = policy::none;
+    else if (s == "exp") tag = policy::exp;
+    else if (s == "adaptive") tag = policy::adaptive;
+    else is.setstate(is.failbit);
+  }
+  return is;
+}
+
+auto val = 0u;
+
+template <typename Backoff>
+std::vector<simulator2::fn_t> get_fn(std::uint8_t thread_cnt) {
+  using alloc_t = lf::allocator<unsigned, lf::packed, lf::cp_t, Backoff>;
+  static lf::stack<unsigned, alloc_t> stk(1_K * thread_cnt * 2);
+  for (std::size_t i = 0; i < 1_K * thread_cnt; ++i) {
+    stk.try_push(i);
+  }
+  return {
+    []() noexcept {
+      (void)stk.try_push(std::move(val));
+    },
+    []() noexcept {
+      (void)stk.try_pop();
+    }
+  };
+}
+
+// Run at 1..N threads to compare how policies scale.
+MAIN(
+ policy tag,
+ unsigned thread_cnt,
+ optional<std::uint16_t, 1> mins) {
+  auto fn = tag == policy::none ? &get_fn<lf::no_backoff> :
+            tag == policy::exp ? &get_fn<lf::exp_backoff<>> :
+            &get_fn<lf::adaptive_backoff<>>;
+  simulator2::configure(thread_cnt, std::chrono::minutes(mins), fn(thread_cnt));
+  simulator2::kickoff();
+  simulator2::print_results();
+}
@@ -0,0 +1,51 @@
+#include "cli.hpp"
+#include "simulator2.hpp"
+
+#include <lf/stack.hpp>
+
+enum struct layout_tag {
+  packed,
+  padded_heads,
+  padded
+};
+
+std::istream& operator>>(std::istream& is, layout_tag& tag) {
+  std::string s;
+  if (is >> s) {
+    if (s == "packed") tag = layout_tag::packed;
+    else if (s == "padded_heads") tag = layout_tag::padded_heads;
+    else if (s == "padded") tag = layout_tag::padded;
+    else is.setstate(is.failbit);
+  }
+  return is;
+}
+
+auto val = 0u;
+
+template <typename Layout>
+std::vector<simulator2::fn_t> get_fn(std::uint8_t thread_cnt) {
+  static lf::stack<unsigned, lf::allocator<unsigned, Layout>> stk(1_K * thread_cnt * 2);
+  for (std::size_t i = 0; i < 1_K * thread_cnt; ++i) {
+    stk.try_push(i);
+  }
+  return {
+    []() noexcept {
+      (void)stk.try_push(std::move(val));
+    },
+    []() noexcept {
+      (void)stk.try_pop();
+    }
+  };
+}
+
+MAIN(
+ layout_tag tag,
+ unsigned thread_cnt,
+ optional<std::uint16_t, 1> mins) {
+  auto fn = tag == layout_tag::packed ? &get_fn<lf::packed> :
+            tag == layout_tag::padded_heads ? &get_fn<lf::padded_heads> :
+            &get_fn<lf::padded>;
+  simulator2::configure(thread_cnt, std::chrono::minutes(mins), fn(thread_cnt));
+  simulator2::kickoff();
+  simulator2::print_results();
+}
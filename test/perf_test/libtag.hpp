@@ -7,12 +7,16 @@
 
 enum struct lib {
   lf,
+  lf_elim,
+  lf_mag,
   boost
 };
 
 inline
 std::string to_str(lib tag) {
-  return tag == lib::lf ? "lf" : "boost";
+  return tag == lib::lf ? "lf" :
+         tag == lib::lf_elim ? "lf_elim" :
+         tag == lib::lf_mag ? "lf_mag" : "boost";
 }
 
 inline
@@ -25,6 +29,8 @@ std::istream& operator>>(std::istream& is, lib& tag) {
   std::string s;
   if (is >> s) {
     if (s == "lf") tag = lib::lf;
+    else if (s == "lf_elim") tag = lib::lf_elim;
+    else if (s == "lf_mag") tag = lib::lf_mag;
     else if (s == "boost") tag = lib::boost;
     else is.setstate(is.failbit);
   }
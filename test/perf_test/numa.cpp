@@ -0,0 +1,56 @@
+#include "cli.hpp"
+#include "simulator2.hpp"
+
+#include <lf/numa_allocator.hpp>
+
+#include <memory>
+
+enum struct placement {
+  local,
+  remote
+};
+
+std::istream& operator>>(std::istream& is, placement& tag) {
+  std::string s;
+  if (is >> s) {
+    if (s == "local") tag = placement::local;
+    else if (s == "remote") tag = placement::remote;
+    else is.setstate(is.failbit);
+  }
+  return is;
+}
+
+std::unique_ptr<lf::numa_allocator<std::uint64_t>> alloc;
+auto remote = false;
+
+thread_local std::vector<std::uint32_t> held;
+
+void allocate() {
+  auto home = alloc->home();
+  if (remote) home = (home + 1) % alloc->shard_cnt();
+  auto p = alloc->try_allocate(home);
+  if (p == lf::null) return;
+  alloc->deref(p).val = p;
+  held.push_back(p);
+}
+
+void deallocate() noexcept {
+  if (held.empty()) return;
+  alloc->deallocate(held.back());
+  held.pop_back();
+}
+
+MAIN(
+ placement tag,
+ unsigned thread_cnt,
+ optional<std::uint16_t, 1> mins) {
+  validate_thread_cnt(thread_cnt);
+  std::uint32_t capacity = 1_M * thread_cnt;
+  alloc = std::make_unique<lf::numa_allocator<std::uint64_t>>(capacity);
+  remote = tag == placement::remote;
+  std::cout << "nodes: " << alloc->shard_cnt() << '\n'
+            << "bound: " << alloc->is_bound() << '\n';
+  simulator2::configure(thread_cnt, std::chrono::minutes(mins), {&allocate, &deallocate});
+  simulator2::kickoff();
+  simulator2::print_results();
+}
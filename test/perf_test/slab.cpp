@@ -0,0 +1,84 @@
+#include "cli.hpp"
+#include "simulator2.hpp"
+
+#include <lf/slab.hpp>
+
+#include <cstdlib>
+#include <memory>
+
+enum struct impl_tag {
+  lf,
+  malloc
+};
+
+std::istream& operator>>(std::istream& is, impl_tag& tag) {
+  std::string s;
+  if (is >> s) {
+    if (s == "lf") tag = impl_tag::lf;
+    else if (s == "malloc") tag = impl_tag::malloc;
+    else is.setstate(is.failbit);
+  }
+  return is;
+}
+
+using slab_t = lf::slab<16, 1024>;
+
+std::unique_ptr<slab_t> slab;
+
+// Message sizes cycle through a mix of small and medium payloads.
+constexpr std::size_t sizes[] = {24, 64, 100, 16, 256, 40, 512, 32, 1000, 80};
+
+thread_local std::vector<std::pair<void*, std::size_t>> held;
+thread_local std::size_t next_size;
+
+std::size_t pick_size() noexcept {
+  next_size = (next_size + 1) % std::size(sizes);
+  return sizes[next_size];
+}
+
+void lf_allocate() {
+  auto n = pick_size();
+  auto p = slab->try_allocate(n);
+  if (!p) return;
+  *(char*)p = 0;
+  held.emplace_back(p, n);
+}
+
+void lf_deallocate() noexcept {
+  if (held.empty()) return;
+  slab->deallocate(held.back().first, held.back().second);
+  held.pop_back();
+}
+
+void malloc_allocate() {
+  auto n = pick_size();
+  auto p = std::malloc(n);
+  if (!p) return;
+  *(char*)p = 0;
+  held.emplace_back(p, n);
+}
+
+void malloc_deallocate() noexcept {
+  if (held.empty()) return;
+  std::free(held.back().first);
+  held.pop_back();
+}
+
+MAIN(
+ impl_tag tag,
+ unsigned thread_cnt,
+ optional<std::uint16_t, 1> mins) {
+  validate_thread_cnt(thread_cnt);
+  if (tag == impl_tag::lf) {
+    // Classes get blocks in proportion to how often `sizes` hits them.
+    auto n = std::uint32_t(8_K * thread_cnt);
+    const std::uint32_t caps[slab_t::class_cnt] = {n, 2 * n, 2 * n, 2 * n, n, n, n};
+    slab = std::make_unique<slab_t>(caps);
+    simulator2::configure(thread_cnt, std::chrono::minutes(mins), {&lf_allocate, &lf_deallocate});
+  }
+  else {
+    simulator2::configure(thread_cnt, std::chrono::minutes(mins), {&malloc_allocate, &malloc_deallocate});
+  }
+  simulator2::kickoff();
+  simulator2::print_results();
+}
@@ -0,0 +1,74 @@
+#include "cli.hpp"
+#include "simulator2.hpp"
+
+#include <lf/soa_allocator.hpp>
+
+#include <memory>
+
+enum struct storage {
+  aos,
+  soa
+};
+
+std::istream& operator>>(std::istream& is, storage& tag) {
+  std::string s;
+  if (is >> s) {
+    if (s == "aos") tag = storage::aos;
+    else if (s == "soa") tag = storage::soa;
+    else is.setstate(is.failbit);
+  }
+  return is;
+}
+
+template <std::size_t Size>
+struct payload {
+  std::uint32_t v[Size / 4];
+};
+
+thread_local std::vector<std::uint32_t> held;
+
+template <typename Alloc>
+std::vector<simulator2::fn_t> get_fn(std::uint32_t capacity) {
+  static auto alloc = std::make_unique<Alloc>(capacity);
+  return {
+    [] {
+      auto p = alloc->try_allocate();
+      if (p == lf::null) return;
+      alloc->deref(p).val.v[0] = p;
+      held.push_back(p);
+    },
+    []() noexcept {
+      if (held.empty()) return;
+      alloc->deallocate(held.back());
+      held.pop_back();
+    }
+  };
+}
+
+template <std::size_t Size>
+std::vector<simulator2::fn_t> get_fn(storage tag, std::uint32_t capacity) {
+  using T = payload<Size>;
+  return tag == storage::aos ?
+   get_fn<lf::allocator<T>>(capacity) :
+   get_fn<lf::soa_allocator<T>>(capacity);
+}
+
+MAIN(
+ storage tag,
+ unsigned size,
+ unsigned thread_cnt,
+ optional<std::uint16_t, 1> mins) {
+  validate_thread_cnt(thread_cnt);
+  std::uint32_t capacity = 256_K * thread_cnt;
+  std::vector<simulator2::fn_t> fn;
+  switch (size) {
+  case 4: fn = get_fn<4>(tag, capacity); break;
+  case 16: fn = get_fn<16>(tag, capacity); break;
+  case 64: fn = get_fn<64>(tag, capacity); break;
+  case 256: fn = get_fn<256>(tag, capacity); break;
+  default: throw std::invalid_argument("size must be 4, 16, 64, or 256.");
+  }
+  simulator2::configure(thread_cnt, std::chrono::minutes(mins), std::move(fn));
+  simulator2::kickoff();
+  simulator2::print_results();
+}
@@ -7,8 +7,9 @@
 
 auto val = 0u;
 
+template <typename Stack = lf::stack<unsigned>>
 std::vector<simulator2::fn_t> get_lf_fn(std::uint8_t thread_cnt) {
-  static lf::stack<unsigned> stk(1_K * thread_cnt * 2);
+  static Stack stk(1_K * thread_cnt * 2);
   for (std::size_t i = 0; i < 1_K * thread_cnt; ++i) {
     stk.try_push(i);
   }
@@ -42,7 +43,12 @@ MAIN(
  lib tag,
  unsigned thread_cnt,
  optional<std::uint16_t, 60> mins) {
-  auto get_fn = tag == lib::lf ? &get_lf_fn : &get_boost_fn;
+  using elim_t = lf::stack<unsigned, lf::allocator<unsigned>, lf::no_backoff, 8>;
+  using mag_t = lf::stack<unsigned, lf::magazine_allocator<unsigned>>;
+  auto get_fn = tag == lib::lf ? &get_lf_fn<> :
+                tag == lib::lf_elim ? &get_lf_fn<elim_t> :
+                tag == lib::lf_mag ? &get_lf_fn<mag_t> :
+                &get_boost_fn;
   simulator2::configure(thread_cnt, std::chrono::minutes(mins), get_fn(thread_cnt));
   simulator2::kickoff();
   simulator2::print_results();
@@ -3,8 +3,21 @@
 
 #include "test.hpp"
 
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 namespace {
 
+struct item {
+  int v;
+};
+
+template <unsigned Stripes = 16>
+using counted_allocator = lf::allocator<
+ item, lf::packed, lf::cp_t, lf::no_backoff, lf::striped_stats<Stripes>>;
+
 void require_capacity_2(lf::allocator<int>& allo) {
   auto p1 = allo.try_allocate();
   REQUIRE(p1 == 0);
@@ -29,6 +42,56 @@ TEST_CASE("allocator") {
     REQUIRE(a2.try_allocate() == lf::null);
     require_capacity_2(a3);
   }
+  SECTION("lazy link") {
+    lf::allocator<int> allo(1u << 28, lf::backing::reserve);
+    REQUIRE(allo.try_allocate() == 0);
+    REQUIRE(allo.try_allocate() == 1);
+    allo.deallocate(0);
+    REQUIRE(allo.try_allocate() == 0);
+    REQUIRE(allo.try_allocate() == 2);
+    allo.reset(1u << 28);
+    REQUIRE(allo.try_allocate() == 0);
+  }
+  SECTION("reserve") {
+    lf::allocator<int> a1(0, lf::backing::reserve), a2(2, lf::backing::reserve);
+    REQUIRE(a1.try_allocate() == lf::null);
+    require_capacity_2(a2);
+    a2.reset(2);
+    require_capacity_2(a2);
+    lf::allocator<int> a3(1u << 30, lf::backing::reserve);
+    std::uint32_t p;
+    REQUIRE(a3.try_allocate_n(3, p) == 3);
+    REQUIRE(p == 0);
+    REQUIRE(a3.deref(0).next == 1);
+    REQUIRE(a3.deref(1).next == 2);
+    REQUIRE(a3.deref(2).next == lf::null);
+    auto seq = true;
+    for (std::uint32_t i = 3; i < (1u << 20); ++i) {
+      seq = seq && a3.try_allocate() == i;
+      a3.deref(i).val = (int)i;
+    }
+    REQUIRE(seq);
+    a3.deallocate_chain(0, 2, 3);
+    REQUIRE(a3.try_allocate() == 0);
+  }
+  SECTION("huge pages") {
+    using lf::backing;
+    lf::allocator<int> a1(2), a2(2, backing::thp), a3(2, backing::hugetlb);
+    REQUIRE(a1.get_backing() == backing::heap);
+    REQUIRE((a2.get_backing() == backing::thp ||
+             a2.get_backing() == backing::reserve));
+    REQUIRE(a3.get_backing() != backing::heap);
+    require_capacity_2(a2);
+    require_capacity_2(a3);
+    a3.reset(2);
+    require_capacity_2(a3);
+    lf::allocator<int> a4(1u << 20, backing::thp);
+    REQUIRE(((std::uintptr_t)&a4.deref(0) & ((1u << 21) - 1)) == 0);
+    for (std::uint32_t i = 0; i < (1u << 20); ++i) {
+      a4.deref(a4.try_allocate()).val = 1;
+    }
+    REQUIRE(a4.try_allocate() == lf::null);
+  }
   SECTION("reset") {
     lf::allocator<int> a;
     REQUIRE(a.try_allocate() == lf::null);
@@ -69,4 +132,220 @@ TEST_CASE("allocator") {
     REQUIRE(allo.try_allocate() == p1);
     REQUIRE(allo.try_allocate() == lf::null);
   }
+  SECTION("batch") {
+    lf::allocator<int> allo(4);
+    std::uint32_t p = lf::null;
+    REQUIRE(allo.try_allocate_n(0, p) == 0);
+    REQUIRE(p == lf::null);
+    REQUIRE(allo.try_allocate_n(3, p) == 3);
+    REQUIRE(p == 0);
+    REQUIRE(allo.deref(0).next == 1);
+    REQUIRE(allo.deref(1).next == 2);
+    REQUIRE(allo.deref(2).next == lf::null);
+    REQUIRE(allo.try_allocate_n(3, p) == 1);
+    REQUIRE(p == 3);
+    REQUIRE(allo.try_allocate_n(3, p) == 0);
+    allo.deallocate(3);
+    allo.deallocate_chain(0, 2, 3);
+    REQUIRE(allo.try_allocate() == 0);
+    REQUIRE(allo.try_allocate() == 1);
+    REQUIRE(allo.try_allocate() == 2);
+    REQUIRE(allo.try_allocate() == 3);
+    REQUIRE(allo.try_allocate() == lf::null);
+  }
+  SECTION("layout") {
+    using packed_node = lf::allocator<int>::node;
+    using padded_node = lf::allocator<int, lf::padded>::node;
+    REQUIRE(sizeof(packed_node) == 8);
+    REQUIRE(sizeof(padded_node) == lf::cache_line);
+    REQUIRE(alignof(padded_node) == lf::cache_line);
+    REQUIRE(sizeof(lf::allocator<int, lf::padded_heads>::node) == 8);
+    lf::allocator<int, lf::padded> allo(2);
+    auto p = allo.try_allocate();
+    auto q = allo.try_allocate();
+    auto d = reinterpret_cast<char*>(&allo.deref(q)) - reinterpret_cast<char*>(&allo.deref(p));
+    REQUIRE(d == lf::cache_line);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(&allo.deref(p)) % lf::cache_line == 0);
+  }
+  SECTION("index width") {
+    using cp16_t = lf::basic_cp<16>;
+    using cp40_t = lf::basic_cp<40>;
+    lf::allocator<int, lf::packed, cp16_t> a1(cp16_t::null);
+    REQUIRE_THROWS_AS(
+     (lf::allocator<int, lf::packed, cp16_t>(cp16_t::null + 1)), std::length_error);
+    std::uint32_t p;
+    REQUIRE(a1.try_allocate_n(cp16_t::null, p) == cp16_t::null);
+    REQUIRE(a1.deref(cp16_t::null - 1).next == cp16_t::null);
+    REQUIRE(a1.try_allocate() == cp16_t::null);
+    a1.deallocate(0);
+    REQUIRE(a1.try_allocate() == 0);
+    lf::allocator<int, lf::packed, cp40_t> a2(2, lf::backing::reserve);
+    REQUIRE_SAME_T(decltype(a2.try_allocate()), std::uint64_t);
+    REQUIRE(a2.try_allocate() == 0);
+    REQUIRE(a2.try_allocate() == 1);
+    REQUIRE(a2.try_allocate() == cp40_t::null);
+    a2.deallocate(1);
+    REQUIRE(a2.try_allocate() == 1);
+  }
+  SECTION("parallel init") {
+    lf::allocator<int> a1(10, lf::backing::reserve, lf::parallel_init{3});
+    for (std::uint32_t i = 0; i < 10; ++i) {
+      REQUIRE(a1.try_allocate() == i);
+    }
+    REQUIRE(a1.try_allocate() == lf::null);
+    lf::allocator<int> a2(0, lf::backing::heap, lf::parallel_init{});
+    REQUIRE(a2.try_allocate() == lf::null);
+    lf::allocator<int> a3(5);
+    REQUIRE(a3.try_allocate() == 0);
+    a3.populate(8);
+    REQUIRE(a3.try_allocate() == 1);
+    std::uint32_t p;
+    REQUIRE(a3.try_allocate_n(5, p) == 3);
+    REQUIRE(p == 2);
+    REQUIRE(a3.deref(4).next == lf::null);
+    a3.populate(2);
+    REQUIRE(a3.try_allocate() == lf::null);
+  }
+  SECTION("magazine") {
+    lf::allocator<int> allo(4);
+    {
+      lf::magazine<lf::allocator<int>, 2> mag(allo);
+      auto p1 = mag.try_allocate();
+      REQUIRE(p1 == 0);
+      REQUIRE(allo.try_allocate() == 1);
+      auto p2 = mag.try_allocate();
+      REQUIRE(p2 == 2);
+      auto p3 = mag.try_allocate();
+      REQUIRE(p3 == 3);
+      REQUIRE(mag.try_allocate() == lf::null);
+      mag.deallocate(p1);
+      mag.deallocate(p2);
+      REQUIRE(allo.try_allocate() == lf::null);
+      mag.deallocate(p3);
+      REQUIRE(allo.try_allocate() == p2);
+      REQUIRE(mag.try_allocate() == p3);
+      REQUIRE(mag.try_allocate() == p1);
+      mag.deallocate(p1);
+      mag.deallocate(p3);
+    }
+    REQUIRE(allo.try_allocate() == 0);
+    REQUIRE(allo.try_allocate() == 3);
+    REQUIRE(allo.try_allocate() == lf::null);
+  }
+  SECTION("wait allocate") {
+    using namespace std::chrono_literals;
+    lf::allocator<int> allo(1);
+    auto p = allo.wait_allocate_for(1ms);
+    REQUIRE(p == 0);
+    REQUIRE(allo.wait_allocate_for(1ms) == lf::null);
+    REQUIRE(allo.wait_allocate_for(-1ms) == lf::null);
+    REQUIRE(allo.wait_allocate_for(0.5ms) == lf::null);
+    std::uint32_t got = lf::null;
+    std::thread waiter([&allo, &got] { got = allo.wait_allocate(); });
+    std::this_thread::sleep_for(10ms);
+    allo.deallocate(p);
+    waiter.join();
+    REQUIRE(got == p);
+    waiter = std::thread([&allo, &got] { got = allo.wait_allocate_for(10s); });
+    std::this_thread::sleep_for(10ms);
+    allo.deallocate_chain(p, p, 1);
+    waiter.join();
+    REQUIRE(got == p);
+    REQUIRE(allo.wait_allocate_for(std::chrono::hours::min()) == lf::null);
+    waiter = std::thread([&allo, &got] {
+      got = allo.wait_allocate_for(std::chrono::hours::max());
+    });
+    std::this_thread::sleep_for(10ms);
+    allo.deallocate(p);
+    waiter.join();
+    REQUIRE(got == p);
+  }
+  SECTION("stats") {
+    SECTION("occupancy") {
+      counted_allocator<> allo(4);
+      auto s = allo.stats();
+      REQUIRE(s.allocations == 0);
+      REQUIRE(s.live == 0);
+      REQUIRE(s.high_water == 0);
+      auto p1 = allo.try_allocate();
+      auto p2 = allo.try_allocate();
+      allo.deallocate(p1);
+      p1 = allo.try_allocate();
+      s = allo.stats();
+      REQUIRE(s.allocations == 3);
+      REQUIRE(s.deallocations == 1);
+      REQUIRE(s.live == 2);
+      REQUIRE(s.high_water == 2);
+      REQUIRE(s.exhaustions == 0);
+      std::uint32_t p;
+      REQUIRE(allo.try_allocate_n(3, p) == 2);
+      REQUIRE(allo.try_allocate() == lf::null);
+      REQUIRE(allo.try_allocate_n(3, p) == 0);
+      s = allo.stats();
+      REQUIRE(s.live == 4);
+      REQUIRE(s.high_water == 4);
+      REQUIRE(s.exhaustions == 2);
+      allo.deallocate_chain(p, p + 1, 2);
+      allo.deallocate(p1);
+      allo.deallocate(p2);
+      s = allo.stats();
+      REQUIRE(s.live == 0);
+      REQUIRE(s.high_water == 4);
+      std::uint64_t ops = 0;
+      for (auto r : s.retries) {
+        ops += r;
+      }
+      REQUIRE(ops == 10);
+      REQUIRE(s.retries[0] == ops);
+    }
+    SECTION("concurrent") {
+      counted_allocator<2> allo(64);
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&allo] {
+          for (int i = 0; i < 10000; ++i) {
+            auto p = allo.try_allocate();
+            if (p != lf::null) allo.deallocate(p);
+          }
+        });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+      auto s = allo.stats();
+      REQUIRE(s.allocations == 40000);
+      REQUIRE(s.deallocations == 40000);
+      REQUIRE(s.live == 0);
+      REQUIRE(s.high_water <= 4);
+      std::uint64_t ops = 0;
+      for (auto r : s.retries) {
+        ops += r;
+      }
+      REQUIRE(ops == 80000);
+    }
+    SECTION("populate") {
+      counted_allocator<> allo(8, lf::backing::heap, lf::parallel_init{2});
+      REQUIRE(allo.stats().high_water == 0);
+      auto p1 = allo.try_allocate();
+      REQUIRE(allo.try_allocate() != lf::null);
+      allo.deallocate(p1);
+      REQUIRE(allo.try_allocate() == p1);
+      auto s = allo.stats();
+      REQUIRE(s.live == 2);
+      REQUIRE(s.high_water == 2);
+      std::uint32_t p;
+      REQUIRE(allo.try_allocate_n(3, p) == 3);
+      REQUIRE(allo.stats().high_water == 5);
+      allo.reset(4);
+      s = allo.stats();
+      REQUIRE(s.allocations == 0);
+      REQUIRE(s.deallocations == 0);
+      REQUIRE(s.high_water == 0);
+      REQUIRE(s.retries[0] == 0);
+    }
+    SECTION("disabled") {
+      REQUIRE(std::is_empty_v<lf::impl::stat_counters<lf::no_stats>>);
+      REQUIRE(sizeof(lf::allocator<item>) < sizeof(counted_allocator<>));
+    }
+  }
 }
@@ -0,0 +1,87 @@
+#include "../../lf/backoff.hpp"
+#include "../../lf/backoff.hpp"
+#include "../../lf/stack.hpp"
+
+#include "test.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename Backoff>
+void stress() {
+  using alloc_t = lf::allocator<int, lf::packed, lf::cp_t, Backoff>;
+  lf::stack<int, alloc_t> stk(64);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&stk] {
+      for (int i = 0; i < 10000; ++i) {
+        (void)stk.try_push(int(i));
+        (void)stk.try_pop();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  while (stk.try_pop());
+  int cnt = 0;
+  while (stk.try_push(0)) ++cnt;
+  REQUIRE(cnt == 64);
+}
+
+} // unnamed namespace
+
+TEST_CASE("backoff") {
+  SECTION("policies") {
+    lf::exp_backoff<1, 4> e;
+    REQUIRE(e.spins() == 1);
+    e();
+    REQUIRE(e.spins() == 2);
+    e();
+    REQUIRE(e.spins() == 4);
+    e();
+    REQUIRE(e.spins() == 4);
+    using ab_t = lf::adaptive_backoff<2, 8>;
+    for (int i = 0; i < 4; ++i) {
+      ab_t{};
+    }
+    REQUIRE(ab_t::spins() == 2);
+    {
+      ab_t a;
+      a();
+      REQUIRE(ab_t::spins() == 4);
+      a();
+      a();
+      REQUIRE(ab_t::spins() == 8);
+    }
+    REQUIRE(ab_t::spins() == 8);
+    ab_t{};
+    REQUIRE(ab_t::spins() == 4);
+    ab_t{};
+    ab_t{};
+    REQUIRE(ab_t::spins() == 2);
+  }
+  SECTION("stack") {
+    using alloc_t = lf::allocator<int, lf::packed, lf::cp_t, lf::exp_backoff<>>;
+    using stack_t = lf::stack<int, alloc_t>;
+    REQUIRE_SAME_T(alloc_t::backoff_type, lf::exp_backoff<>);
+    REQUIRE_SAME_T(
+     lf::impl::backoff_of_t<alloc_t>, lf::exp_backoff<>);
+    REQUIRE_SAME_T(
+     lf::impl::backoff_of_t<lf::allocator<int>>, lf::no_backoff);
+    stack_t stk(1);
+    REQUIRE(stk.try_push(1));
+    REQUIRE_FALSE(stk.try_push(2));
+    REQUIRE(stk.try_pop() == 1);
+    lf::stack<int, lf::allocator<int>, lf::adaptive_backoff<>> stk2(1);
+    REQUIRE(stk2.try_push(1));
+    REQUIRE(stk2.try_pop() == 1);
+  }
+  SECTION("concurrent") {
+    stress<lf::no_backoff>();
+    stress<lf::exp_backoff<>>();
+    stress<lf::adaptive_backoff<>>();
+  }
+}
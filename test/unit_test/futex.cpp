@@ -0,0 +1,30 @@
+#include "../../lf/futex.hpp"
+#include "../../lf/futex.hpp"
+
+#include "test.hpp"
+
+#include <chrono>
+#include <thread>
+
+TEST_CASE("futex") {
+  using namespace std::chrono_literals;
+  std::atomic_uint32_t word{1};
+  SECTION("wait") {
+    lf::futex_wait(word, 0);
+    lf::futex_wait_for(word, 0, 1s);
+    auto t0 = std::chrono::steady_clock::now();
+    lf::futex_wait_for(word, 1, 5ms);
+    REQUIRE(std::chrono::steady_clock::now() - t0 >= 5ms);
+    lf::futex_wait_for(word, 1, 0ms);
+  }
+  SECTION("wake") {
+    std::thread waiter([&word] {
+      while (word.load() == 1) lf::futex_wait(word, 1);
+    });
+    std::this_thread::sleep_for(5ms);
+    word = 2;
+    lf::futex_wake(word);
+    waiter.join();
+    REQUIRE(word == 2);
+  }
+}
@@ -0,0 +1,90 @@
+#include "../../lf/growable_allocator.hpp"
+#include "../../lf/growable_allocator.hpp"
+
+#include "test.hpp"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("growable_allocator") {
+  SECTION("ctor") {
+    lf::growable_allocator<int> a1, a2(0), a3(3);
+    REQUIRE(a1.capacity() == 0);
+    REQUIRE(a2.capacity() == 0);
+    REQUIRE(a3.capacity() == 4);
+    REQUIRE(a1.try_allocate() == 0);
+    REQUIRE(a1.capacity() == 1);
+    REQUIRE(a1.try_allocate() == 1);
+    REQUIRE(a1.capacity() == 3);
+  }
+  SECTION("grow") {
+    lf::growable_allocator<int> allo(2);
+    for (std::uint32_t i = 0; i < 2; ++i) {
+      REQUIRE(allo.try_allocate() == i);
+    }
+    REQUIRE(allo.capacity() == 2);
+    for (std::uint32_t i = 2; i < 6; ++i) {
+      REQUIRE(allo.try_allocate() == i);
+    }
+    REQUIRE(allo.capacity() == 6);
+    REQUIRE(allo.try_grow());
+    REQUIRE(allo.capacity() == 14);
+    for (std::uint32_t i = 0; i < 14; ++i) {
+      if (i < 6) allo.deref(i).val = (int)i;
+      else REQUIRE(allo.try_allocate() == i);
+    }
+    for (std::uint32_t i = 0; i < 6; ++i) {
+      REQUIRE(allo.deref(i).val == (int)i);
+    }
+    REQUIRE(&allo.deref(1) - &allo.deref(0) == 1);
+    REQUIRE(&allo.deref(5) - &allo.deref(2) == 3);
+    REQUIRE(&allo.deref(13) - &allo.deref(6) == 7);
+    allo.deallocate(3);
+    allo.deallocate(7);
+    REQUIRE(allo.try_allocate() == 7);
+    REQUIRE(allo.try_allocate() == 3);
+    REQUIRE(allo.try_allocate() == 14);
+    REQUIRE(allo.capacity() == 30);
+    REQUIRE(allo.try_grow());
+    REQUIRE(allo.capacity() == 62);
+    for (std::uint32_t i = 15; i < 30; ++i) {
+      REQUIRE(allo.try_allocate() == i);
+    }
+    REQUIRE(allo.try_allocate() == 30);
+  }
+  SECTION("batch") {
+    lf::growable_allocator<int> allo(2);
+    std::uint32_t p;
+    REQUIRE(allo.try_allocate_n(3, p) == 2);
+    REQUIRE(p == 0);
+    REQUIRE(allo.try_allocate_n(3, p) == 3);
+    REQUIRE(p == 2);
+    allo.deallocate_chain(2, 4, 3);
+    REQUIRE(allo.try_allocate() == 2);
+  }
+  SECTION("concurrent") {
+    lf::growable_allocator<std::uint32_t> allo(1);
+    std::vector<std::uint32_t> ptrs[4];
+    std::vector<std::thread> threads;
+    for (auto& v : ptrs) {
+      threads.emplace_back([&allo, &v] {
+        for (auto i = 0; i < 1000; ++i) {
+          auto p = allo.try_allocate();
+          allo.deref(p).val = p;
+          v.push_back(p);
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+    REQUIRE(allo.capacity() == 4095);
+    std::vector<bool> seen(allo.capacity());
+    for (auto& v : ptrs) {
+      for (auto p : v) {
+        REQUIRE(p < seen.size());
+        REQUIRE_FALSE(seen[p]);
+        seen[p] = true;
+        REQUIRE(allo.deref(p).val == p);
+      }
+    }
+  }
+}
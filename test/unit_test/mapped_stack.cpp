@@ -0,0 +1,89 @@
+#include "../../lf/mapped_stack.hpp"
+#include "../../lf/mapped_stack.hpp"
+
+#include "test.hpp"
+
+#include <cstdio>
+#include <string>
+
+#include <sys/wait.h>
+
+TEST_CASE("mapped_stack") {
+  SECTION("shm") {
+    auto name = "/lf_unit_test_" + std::to_string(getpid());
+    using mstk_t = lf::mapped_stack<triple>;
+    auto s1 = mstk_t::create_shm(name.c_str(), 2);
+    REQUIRE_THROWS(mstk_t::create_shm(name.c_str(), 2));
+    auto s2 = mstk_t::open_shm(name.c_str());
+    mstk_t::unlink_shm(name.c_str());
+    REQUIRE_THROWS(mstk_t::open_shm(name.c_str()));
+    REQUIRE(&*s1 != &*s2);
+    REQUIRE(s1->try_push({1, 2, 3}));
+    REQUIRE(s2->try_push({4, 5, 6}));
+    REQUIRE_FALSE(s1->try_push({7, 8, 9}));
+    REQUIRE(memcmp(s1->try_pop().value(), triple{4, 5, 6}));
+    REQUIRE(memcmp(s2->try_pop().value(), triple{1, 2, 3}));
+    REQUIRE_FALSE(s1->try_pop());
+    REQUIRE_FALSE(mstk_t::attach(s1.native_handle())->try_pop());
+    REQUIRE_THROWS(lf::mapped_stack<int>::attach(s1.native_handle()));
+  }
+  SECTION("file") {
+    auto path = "/tmp/lf_unit_test_" + std::to_string(getpid());
+    using mstk_t = lf::mapped_stack<int>;
+    {
+      auto s = mstk_t::open_file(path.c_str(), 3);
+      REQUIRE_THROWS(mstk_t::open_file(path.c_str(), 3));
+      REQUIRE(s->try_push(1));
+      REQUIRE(s->try_push(2));
+    }
+    {
+      auto s = mstk_t::open_file(path.c_str(), 100);
+      REQUIRE(s->try_pop().value() == 2);
+      REQUIRE(s->try_push(3));
+      REQUIRE(s->try_push(4));
+      REQUIRE_FALSE(s->try_push(5));
+    }
+    auto pid = fork();
+    if (pid == 0) {
+      auto s = mstk_t::open_file(path.c_str(), 3);
+      (void)s->try_pop();
+      (void)s->try_push(6);
+      _exit(0);
+    }
+    REQUIRE(pid > 0);
+    int status;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    {
+      auto s = mstk_t::open_file(path.c_str(), 3);
+      REQUIRE(s->try_pop().value() == 6);
+      REQUIRE(s->try_push(7));
+      REQUIRE_FALSE(s->try_push(8));
+      REQUIRE(s->try_pop().value() == 7);
+      REQUIRE(s->try_pop().value() == 3);
+      REQUIRE(s->try_pop().value() == 1);
+      REQUIRE_FALSE(s->try_pop());
+    }
+    std::remove(path.c_str());
+  }
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  SECTION("memfd") {
+    auto s = lf::mapped_stack<int>::create_memfd(100);
+    auto pid = fork();
+    if (pid == 0) {
+      auto c = lf::mapped_stack<int>::attach(s.native_handle());
+      for (auto i = 0; i < 100; ++i) (void)c->try_push(int(i));
+      _exit(0);
+    }
+    REQUIRE(pid > 0);
+    int status;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    auto sum = 0, cnt = 0;
+    while (auto v = s->try_pop()) {
+      sum += *v;
+      ++cnt;
+    }
+    REQUIRE(cnt == 100);
+    REQUIRE(sum == 4950);
+  }
+#endif
+}
@@ -47,6 +47,19 @@ TEST_CASE("memory") {
     lf::deallocate(pp);
     lf::deallocate(p);
     lf::deallocate(nullptr);
+    REQUIRE_FALSE(lf::try_allocate<int>(0));
+    p = lf::try_allocate<int>(2);
+    REQUIRE(p);
+    p[0] = 1;
+    p[1] = 2;
+    lf::deallocate(p);
+    struct alignas(128) big { char c; };
+    auto pb = lf::allocate<big>(3);
+    REQUIRE((std::uintptr_t)pb % 128 == 0);
+    lf::deallocate(pb);
+    pb = lf::try_allocate<big>();
+    REQUIRE((std::uintptr_t)pb % 128 == 0);
+    lf::deallocate(pb);
   }
   SECTION("init/uninit") {
     auto p = alloc<stru>();
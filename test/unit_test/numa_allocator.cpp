@@ -0,0 +1,27 @@
+#include "../../lf/numa_allocator.hpp"
+#include "../../lf/numa_allocator.hpp"
+
+#include "test.hpp"
+
+TEST_CASE("numa_allocator") {
+  SECTION("ctor") {
+    lf::numa_allocator<int> a1, a2(4, 2);
+    REQUIRE(a1.try_allocate() == lf::null);
+    REQUIRE(a2.shard_cnt() == 2);
+    REQUIRE(lf::numa_allocator<int>(1).shard_cnt() == lf::vm_numa_node_cnt());
+  }
+  SECTION("local first") {
+    lf::numa_allocator<int> allo(4, 2);
+    auto home = allo.home();
+    REQUIRE(home == lf::vm_numa_node() % 2);
+    auto p1 = allo.try_allocate();
+    auto p2 = allo.try_allocate();
+    auto p3 = allo.try_allocate();
+    REQUIRE(allo.owner(p1) == home);
+    REQUIRE(allo.owner(p2) == home);
+    REQUIRE(allo.owner(p3) != home);
+    allo.deref(p3).val = 3;
+    allo.deallocate(p1);
+    REQUIRE(allo.try_allocate() == p1);
+  }
+}
@@ -0,0 +1,132 @@
+#include "../../lf/pool_resource.hpp"
+#include "../../lf/pool_resource.hpp"
+
+#include "test.hpp"
+
+#ifdef LF_HAS_MEMORY_RESOURCE
+
+#include <list>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct counting_resource: std::pmr::memory_resource {
+  int cnt{};
+
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    ++cnt;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+    --cnt;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+} // unnamed namespace
+
+TEST_CASE("pool_resource") {
+  SECTION("fixed size") {
+    counting_resource up;
+    lf::pool_resource<16> res(2, &up);
+    REQUIRE(res.upstream_resource() == &up);
+    auto p1 = res.allocate(16);
+    auto p2 = res.allocate(8, 8);
+    REQUIRE(res.owns(p1));
+    REQUIRE(res.owns(p2));
+    REQUIRE((std::uintptr_t)p1 % alignof(std::max_align_t) == 0);
+    REQUIRE(up.cnt == 0);
+    auto p3 = res.allocate(16);
+    REQUIRE_FALSE(res.owns(p3));
+    REQUIRE(up.cnt == 1);
+    res.deallocate(p3, 16);
+    REQUIRE(up.cnt == 0);
+    res.deallocate(p1, 16);
+    REQUIRE(res.allocate(16) == p1);
+    res.deallocate(p1, 16);
+    res.deallocate(p2, 8, 8);
+  }
+  SECTION("fallback") {
+    counting_resource up;
+    lf::pool_resource<16, 8> res(2, &up);
+    auto p1 = res.allocate(17);
+    auto p2 = res.allocate(16, 16);
+    REQUIRE_FALSE(res.owns(p1));
+    REQUIRE_FALSE(res.owns(p2));
+    REQUIRE(up.cnt == 2);
+    res.deallocate(p1, 17);
+    res.deallocate(p2, 16, 16);
+    REQUIRE(up.cnt == 0);
+    lf::pool_resource<16> empty(0, &up);
+    auto p3 = empty.allocate(1);
+    REQUIRE_FALSE(empty.owns(p3));
+    empty.deallocate(p3, 1);
+    REQUIRE(up.cnt == 0);
+    REQUIRE(res.is_equal(res));
+    REQUIRE_FALSE(res.is_equal(empty));
+  }
+  SECTION("pmr container") {
+    counting_resource up;
+    lf::pool_resource<64> res(8, &up);
+    {
+      std::pmr::list<int> lst(&res);
+      for (int i = 0; i < 8; ++i) {
+        lst.push_back(i);
+      }
+      REQUIRE(up.cnt == 0);
+      lst.push_back(8);
+      REQUIRE(up.cnt == 1);
+    }
+    REQUIRE(up.cnt == 0);
+  }
+  SECTION("pool_allocator") {
+    counting_resource up;
+    lf::pool_resource<64> res(8, &up);
+    using alloc_t = lf::pool_allocator<int, lf::pool_resource<64>>;
+    alloc_t a(res);
+    lf::pool_allocator<long, lf::pool_resource<64>> b(a);
+    REQUIRE(a == b);
+    REQUIRE(b.resource() == &res);
+    std::list<int, alloc_t> lst(a);
+    for (int i = 0; i < 8; ++i) {
+      lst.push_back(i);
+    }
+    REQUIRE(up.cnt == 0);
+    lst.clear();
+    lf::pool_resource<64> other(0, &up);
+    REQUIRE(a != alloc_t(other));
+  }
+  SECTION("concurrent") {
+    lf::pool_resource<8> res(1000, std::pmr::null_memory_resource());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&res] {
+        for (int i = 0; i < 10000; ++i) {
+          auto p = (int*)res.allocate(sizeof(int), alignof(int));
+          *p = i;
+          res.deallocate(p, sizeof(int), alignof(int));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    std::vector<void*> ps;
+    for (int i = 0; i < 1000; ++i) {
+      ps.push_back(res.allocate(8));
+    }
+    REQUIRE_THROWS_AS(res.allocate(8), std::bad_alloc);
+    for (auto p : ps) {
+      res.deallocate(p, 8);
+    }
+  }
+}
+
+#endif // LF_HAS_MEMORY_RESOURCE
@@ -0,0 +1,69 @@
+#include "../../lf/sharded_allocator.hpp"
+#include "../../lf/sharded_allocator.hpp"
+
+#include "test.hpp"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("sharded_allocator") {
+  SECTION("ctor") {
+    lf::sharded_allocator<int> a1, a2(0, 2), a3(5, 2), a4(1, 4);
+    REQUIRE(a1.try_allocate() == lf::null);
+    REQUIRE(a2.try_allocate() == lf::null);
+    REQUIRE(a2.shard_cnt() == 2);
+    REQUIRE(a3.shard_cnt() == 2);
+    REQUIRE(a4.try_allocate() == 0);
+    REQUIRE(a4.try_allocate() == lf::null);
+    REQUIRE(lf::sharded_allocator<int>(1).shard_cnt() ==
+            lf::sharded_allocator<int>::default_shard_cnt());
+  }
+  SECTION("home/steal") {
+    lf::sharded_allocator<int> allo(5, 2);
+    REQUIRE(allo.owner(0) == 0);
+    REQUIRE(allo.owner(2) == 0);
+    REQUIRE(allo.owner(3) == 1);
+    REQUIRE(allo.owner(4) == 1);
+    REQUIRE(allo.try_allocate(1) == 3);
+    REQUIRE(allo.try_allocate(1) == 4);
+    REQUIRE(allo.try_allocate(1) == 0);
+    REQUIRE(allo.try_allocate(0) == 1);
+    REQUIRE(allo.try_allocate(0) == 2);
+    REQUIRE(allo.try_allocate(0) == lf::null);
+    allo.deallocate(0);
+    allo.deallocate(4);
+    REQUIRE(allo.try_allocate(1) == 4);
+    REQUIRE(allo.try_allocate(1) == 0);
+    allo.deallocate(3);
+    REQUIRE(allo.try_allocate(0) == 3);
+    REQUIRE(&allo.deref(4) - &allo.deref(0) == 4);
+  }
+  SECTION("concurrent") {
+    lf::sharded_allocator<std::uint32_t> allo(4000, 3);
+    std::vector<std::uint32_t> ptrs[4];
+    std::vector<std::thread> threads;
+    for (auto& v : ptrs) {
+      threads.emplace_back([&allo, &v] {
+        for (auto i = 0; i < 1000; ++i) {
+          auto p = allo.try_allocate();
+          allo.deref(p).val = p;
+          v.push_back(p);
+          if (i % 3 == 0) {
+            allo.deallocate(p);
+            v.pop_back();
+          }
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+    std::vector<bool> seen(4000);
+    for (auto& v : ptrs) {
+      for (auto p : v) {
+        REQUIRE(p < seen.size());
+        REQUIRE_FALSE(seen[p]);
+        seen[p] = true;
+        REQUIRE(allo.deref(p).val == p);
+      }
+    }
+  }
+}
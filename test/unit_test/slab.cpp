@@ -0,0 +1,104 @@
+#include "../../lf/slab.hpp"
+#include "../../lf/slab.hpp"
+
+#include "test.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST_CASE("slab") {
+  SECTION("size class") {
+    using slab_t = lf::slab<16, 256>;
+    static_assert(slab_t::class_cnt == 5);
+    static_assert(slab_t::size_class(1) == 0);
+    static_assert(slab_t::size_class(16) == 0);
+    static_assert(slab_t::size_class(17) == 1);
+    static_assert(slab_t::size_class(32) == 1);
+    static_assert(slab_t::size_class(33) == 2);
+    static_assert(slab_t::size_class(256) == 4);
+    static_assert(slab_t::class_size(4) == 256);
+  }
+  SECTION("ctor") {
+    lf::slab<16, 64> s1, s2(0);
+    REQUIRE_FALSE(s1.try_allocate(1));
+    REQUIRE_FALSE(s2.try_allocate(64));
+    REQUIRE_THROWS_AS(s2.allocate(1), std::bad_alloc);
+    lf::slab<16, 64> s3({3, 0, 1});
+    for (auto i = 0; i < 3; ++i) {
+      REQUIRE(s3.try_allocate(16));
+    }
+    REQUIRE_FALSE(s3.try_allocate(16));
+    REQUIRE_FALSE(s3.try_allocate(32));
+    auto p = s3.try_allocate(64);
+    REQUIRE(p);
+    REQUIRE_FALSE(s3.try_allocate(64));
+    s3.deallocate(p, 64);
+    REQUIRE(s3.try_allocate(33) == p);
+  }
+  SECTION("allocate/deallocate") {
+    lf::slab<16, 64> s(2);
+    auto p1 = s.try_allocate(10);
+    auto p2 = s.try_allocate(16);
+    REQUIRE(p1);
+    REQUIRE(p2);
+    REQUIRE((char*)p2 - (char*)p1 == 16);
+    REQUIRE_FALSE(s.try_allocate(1));
+    auto p3 = s.allocate(64);
+    auto p4 = s.allocate(33);
+    REQUIRE((char*)p4 - (char*)p3 == 64);
+    REQUIRE((std::uintptr_t)p3 % alignof(std::max_align_t) == 0);
+    REQUIRE_FALSE(s.try_allocate(65));
+    std::memset(p3, 0xff, 64);
+    s.deallocate(p1, 10);
+    REQUIRE(s.try_allocate(3) == p1);
+    s.deallocate(p4, 40);
+    s.deallocate(p3, 64);
+    REQUIRE(s.try_allocate(64) == p3);
+    REQUIRE(s.try_allocate(64) == p4);
+  }
+  SECTION("concurrent") {
+    lf::slab<16, 1024> s(64);
+    std::atomic_bool ok{true};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&s, &ok, t] {
+        std::vector<std::pair<void*, std::size_t>> held;
+        auto intact = true;
+        for (std::size_t i = 0; i < 10000; ++i) {
+          auto bytes = 1 + (i * 37 + t) % 1024;
+          if (auto p = s.try_allocate(bytes)) {
+            std::memset(p, t, bytes);
+            held.emplace_back(p, bytes);
+          }
+          if (held.size() > 8 || i % 3 == 0) {
+            while (!held.empty()) {
+              auto [p, n] = held.back();
+              intact &= ((unsigned char*)p)[n - 1] == t;
+              s.deallocate(p, n);
+              held.pop_back();
+            }
+          }
+        }
+        for (auto [p, n] : held) {
+          s.deallocate(p, n);
+        }
+        if (!intact) ok = false;
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    REQUIRE(ok);
+    for (unsigned k = 0; k < s.class_cnt; ++k) {
+      std::vector<void*> ps;
+      while (auto p = s.try_allocate(s.class_size(k))) {
+        ps.push_back(p);
+      }
+      REQUIRE(ps.size() == 64);
+      for (auto p : ps) {
+        s.deallocate(p, s.class_size(k));
+      }
+    }
+  }
+}
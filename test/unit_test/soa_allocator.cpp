@@ -0,0 +1,52 @@
+#include "../../lf/soa_allocator.hpp"
+#include "../../lf/soa_allocator.hpp"
+
+#include "test.hpp"
+
+TEST_CASE("soa_allocator") {
+  SECTION("ctor") {
+    lf::soa_allocator<int> a1, a2(0), a3(1);
+    REQUIRE(a1.try_allocate() == lf::null);
+    REQUIRE(a2.try_allocate() == lf::null);
+    REQUIRE(a3.capacity() == 1);
+    REQUIRE(a3.try_allocate() == 0);
+    REQUIRE(a3.try_allocate() == lf::null);
+  }
+  SECTION("deref/del") {
+    using ci_t = counted<int>;
+    lf::soa_allocator<ci_t> allo(2);
+    auto p = allo.try_allocate();
+    auto q = allo.try_allocate();
+    REQUIRE(allo.try_allocate() == lf::null);
+    lf::init(&allo.deref(p).val, 1);
+    lf::init(&allo.deref(q).val, 2);
+    REQUIRE(ci_t::inst_cnt == 2);
+    REQUIRE(&allo.deref(q).val - &allo.deref(p).val == 1);
+    REQUIRE(&allo.deref(q).next - &allo.deref(p).next == 1);
+    allo.del(p);
+    allo.del(q);
+    REQUIRE(ci_t::inst_cnt == 0);
+    REQUIRE(allo.deref(q).next == p);
+    REQUIRE(allo.try_allocate() == q);
+    REQUIRE(allo.try_allocate() == p);
+  }
+  SECTION("batch") {
+    lf::soa_allocator<int> allo(3);
+    std::uint32_t p;
+    REQUIRE(allo.try_allocate_n(2, p) == 2);
+    REQUIRE(p == 0);
+    REQUIRE(allo.deref(0).next == 1);
+    REQUIRE(allo.deref(1).next == lf::null);
+    allo.deallocate_chain(0, 1, 2);
+    REQUIRE(allo.try_allocate_n(3, p) == 2);
+    REQUIRE(p == 0);
+    REQUIRE(allo.try_allocate() == 2);
+  }
+  SECTION("reset") {
+    lf::soa_allocator<int> allo;
+    allo.reset(2);
+    REQUIRE(allo.try_allocate() == 0);
+    REQUIRE(allo.try_allocate() == 1);
+    REQUIRE(allo.try_allocate() == lf::null);
+  }
+}
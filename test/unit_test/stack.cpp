@@ -1,13 +1,21 @@
 #include "../../lf/stack.hpp"
 #include "../../lf/stack.hpp"
+#include "../../lf/sharded_allocator.hpp"
+#include "../../lf/soa_allocator.hpp"
 
 #include "test.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 using ci_t = counted<int>;
 
 namespace {
 
-void require_capacity_2(lf::stack<ci_t>& stk) {
+template <typename Stack>
+void require_capacity_2(Stack& stk) {
   REQUIRE_FALSE(stk.try_pop());
   REQUIRE(stk.try_push(ci_t(1)));
   REQUIRE(stk.try_push(ci_t(2)));
@@ -48,4 +56,407 @@ TEST_CASE("stack") {
     REQUIRE(ci_t::inst_cnt == 0);
     REQUIRE_FALSE(s.try_push(ci_t(1)));
   }
+  SECTION("layout") {
+    lf::stack<ci_t, lf::allocator<ci_t, lf::padded>> s1(2);
+    lf::stack<ci_t, lf::allocator<ci_t, lf::padded_heads>> s2(2);
+    require_capacity_2(s1);
+    require_capacity_2(s2);
+    REQUIRE(sizeof(s2) % lf::cache_line == 0);
+  }
+  SECTION("soa allocator") {
+    lf::stack<ci_t, lf::soa_allocator<ci_t>> s1(2);
+    require_capacity_2(s1);
+    s1.reset(2);
+    require_capacity_2(s1);
+  }
+  SECTION("index width") {
+    lf::stack<ci_t, lf::allocator<ci_t, lf::packed, lf::basic_cp<16>>> s1(2);
+    lf::stack<ci_t, lf::allocator<ci_t, lf::packed, lf::basic_cp<40>>> s2(2);
+    require_capacity_2(s1);
+    require_capacity_2(s2);
+  }
+  SECTION("parallel init") {
+    lf::stack<ci_t> s1(2, lf::backing::heap, lf::parallel_init{2});
+    require_capacity_2(s1);
+  }
+  SECTION("shared pool") {
+    lf::allocator<ci_t> pool(3);
+    using shared_t = lf::stack<ci_t, lf::allocator<ci_t>&>;
+    shared_t s2(pool);
+    {
+      shared_t s1(pool);
+      REQUIRE(s1.try_push(ci_t(1)));
+      REQUIRE(s1.try_push(ci_t(2)));
+      REQUIRE(s2.try_push(ci_t(3)));
+      REQUIRE_FALSE(s2.try_push(ci_t(4)));
+      REQUIRE_FALSE(s1.try_push(ci_t(4)));
+      REQUIRE(ci_t::inst_cnt == 3);
+      REQUIRE(s1.try_pop().value().cnt == 2);
+      REQUIRE(s2.try_push(ci_t(4)));
+      REQUIRE(ci_t::inst_cnt == 3);
+    }
+    REQUIRE(ci_t::inst_cnt == 2);
+    REQUIRE(s2.try_push(ci_t(5)));
+    REQUIRE(s2.try_pop().value().cnt == 5);
+    REQUIRE(s2.try_pop().value().cnt == 4);
+    REQUIRE(s2.try_pop().value().cnt == 3);
+    REQUIRE_FALSE(s2.try_pop());
+    REQUIRE(ci_t::inst_cnt == 0);
+    {
+      shared_t s3(pool);
+      REQUIRE(s3.try_push(ci_t(1)));
+      REQUIRE(s3.try_push(ci_t(2)));
+    }
+    REQUIRE(ci_t::inst_cnt == 0);
+    lf::sharded_allocator<ci_t> spool(2, 2);
+    lf::stack<ci_t, lf::sharded_allocator<ci_t>&> s4(spool), s5(spool);
+    REQUIRE(s4.try_push(ci_t(1)));
+    REQUIRE(s5.try_push(ci_t(2)));
+    REQUIRE_FALSE(s5.try_push(ci_t(3)));
+    using counted_t = lf::allocator<
+     ci_t, lf::packed, lf::cp_t, lf::no_backoff, lf::striped_stats<>>;
+    REQUIRE(lf::impl::has_deallocate_chain_v<counted_t>);
+    REQUIRE_FALSE(lf::impl::has_deallocate_chain_v<lf::sharded_allocator<ci_t>>);
+    counted_t cpool(4);
+    {
+      lf::stack<ci_t, counted_t&> s6(cpool);
+      for (int i = 0; i < 3; ++i) {
+        REQUIRE(s6.try_push(ci_t(i)));
+      }
+    }
+    REQUIRE(ci_t::inst_cnt == 2);
+    auto st = cpool.stats();
+    REQUIRE(st.live == 0);
+    REQUIRE(st.deallocations == 3);
+    std::uint64_t ops = 0;
+    for (auto r : st.retries) {
+      ops += r;
+    }
+    REQUIRE(ops == 4);
+  }
+  SECTION("elimination") {
+    lf::impl::exchanger<1, lf::cp_t> ex;
+    REQUIRE(ex.try_take() == lf::null);
+    REQUIRE_FALSE(ex.try_offer(3));
+    REQUIRE(ex.try_take() == lf::null);
+    std::atomic_bool offered{};
+    std::thread pusher([&ex, &offered] {
+      while (!ex.try_offer(5));
+      offered = true;
+    });
+    std::uint32_t p;
+    while ((p = ex.try_take()) == lf::null);
+    pusher.join();
+    REQUIRE(p == 5);
+    REQUIRE(offered);
+    REQUIRE(ex.try_take() == lf::null);
+    REQUIRE(sizeof(lf::stack<int, lf::allocator<int>&>) == 16);
+    REQUIRE(sizeof(lf::waitable_stack<int, lf::allocator<int>&>) == 24);
+    using elim_t = lf::stack<ci_t, lf::allocator<ci_t>, lf::no_backoff, 4>;
+    elim_t s1(2);
+    require_capacity_2(s1);
+    using wide_t = lf::allocator<ci_t, lf::packed, lf::basic_cp<40>>;
+    lf::stack<ci_t, wide_t, lf::no_backoff, 4> s3(2);
+    require_capacity_2(s3);
+    lf::impl::exchanger<1, lf::basic_cp<40>> wide_ex;
+    REQUIRE_FALSE(wide_ex.try_offer(3));
+    REQUIRE(wide_ex.try_take() == lf::basic_cp<40>::null);
+    lf::stack<int, lf::allocator<int>, lf::no_backoff, 4> s2(64);
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> popped(4);
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&s2, &popped, t] {
+        for (int i = 0; i < 10000; ++i) {
+          while (!s2.try_push(t * 10000 + i));
+          if (auto v = s2.try_pop()) popped[t].push_back(*v);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    std::vector<int> all;
+    while (auto v = s2.try_pop()) all.push_back(*v);
+    for (auto& v : popped) {
+      all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto ok = all.size() == 40000;
+    for (std::size_t i = 0; ok && i < all.size(); ++i) {
+      ok = all[i] == int(i);
+    }
+    REQUIRE(ok);
+  }
+  SECTION("batch") {
+    lf::stack<ci_t> stk(4);
+    std::vector<ci_t> v{1, 2, 3};
+    REQUIRE(stk.try_push_range(v.begin(), v.begin()));
+    REQUIRE(stk.try_push_range(v.begin(), v.end()));
+    REQUIRE(ci_t::inst_cnt == 6);
+    REQUIRE_FALSE(stk.try_push_range(v.begin(), v.end()));
+    REQUIRE(ci_t::inst_cnt == 6);
+    REQUIRE(stk.try_push(ci_t(4)));
+    REQUIRE_FALSE(stk.try_push(ci_t(5)));
+    REQUIRE(stk.try_pop().value().cnt == 4);
+    {
+      auto all = stk.pop_all();
+      REQUIRE_FALSE(stk.try_pop());
+      std::vector<int> got;
+      for (auto& x : all) {
+        got.push_back(x.cnt);
+      }
+      REQUIRE(got == std::vector<int>{3, 2, 1});
+      REQUIRE(all.empty());
+      REQUIRE(ci_t::inst_cnt == 3);
+    }
+    REQUIRE(stk.pop_all().empty());
+    REQUIRE(stk.try_push_range(v.begin(), v.end()));
+    stk.pop_all();
+    REQUIRE(ci_t::inst_cnt == 3);
+    v.clear();
+    REQUIRE(ci_t::inst_cnt == 0);
+    std::vector<ci_t> big{1, 2, 3, 4};
+    REQUIRE(stk.try_push_range(
+     std::make_move_iterator(big.begin()), std::make_move_iterator(big.end())));
+    auto all = stk.pop_all();
+    auto it = all.begin();
+    REQUIRE(it->cnt == 4);
+    ++it;
+    REQUIRE((*it).cnt == 3);
+    {
+      auto moved = std::move(all);
+      REQUIRE(all.empty());
+      REQUIRE_FALSE(moved.empty());
+      REQUIRE(ci_t::inst_cnt == 3);
+    }
+    REQUIRE(ci_t::inst_cnt == 0);
+  }
+  SECTION("batch/throw") {
+    struct thrower {
+      int v;
+      thrower(int v): v(v) {}
+      thrower(const thrower& t): v(t.v) {
+        if (v == 3) throw 0;
+      }
+      thrower(thrower&&) = default;
+    };
+    lf::stack<thrower> stk(4);
+    std::vector<thrower> v;
+    for (int i = 1; i <= 4; ++i) {
+      v.emplace_back(i);
+    }
+    REQUIRE_THROWS(stk.try_push_range(v.begin(), v.end()));
+    REQUIRE_FALSE(stk.try_pop());
+    REQUIRE(stk.try_push_range(v.begin(), v.begin() + 2));
+    REQUIRE(stk.try_push(thrower(5)));
+    REQUIRE(stk.try_push(thrower(6)));
+    REQUIRE(stk.try_pop()->v == 6);
+  }
+  SECTION("emplace/copy") {
+    struct msg {
+      int id;
+      ci_t ci;
+      char body[200]{};
+    };
+    lf::stack<msg> s1(2);
+    REQUIRE(s1.try_emplace(1, ci_t(7)));
+    REQUIRE(ci_t::inst_cnt == 1);
+    auto m = s1.try_pop();
+    REQUIRE(m->id == 1);
+    REQUIRE(m->ci.cnt == 7);
+    m.reset();
+    lf::stack<ci_t> s2(2);
+    ci_t c(3);
+    REQUIRE(s2.try_push(c));
+    REQUIRE(s2.try_emplace(4));
+    REQUIRE_FALSE(s2.try_emplace(5));
+    REQUIRE(ci_t::inst_cnt == 3);
+    REQUIRE(s2.try_pop()->cnt == 4);
+    REQUIRE(s2.try_pop()->cnt == 3);
+    lf::stack<std::vector<int>> s3(1);
+    REQUIRE(s3.try_emplace(2, 1));
+    REQUIRE(s3.try_pop() == std::vector<int>{1, 1});
+    struct thrower {
+      thrower(int v) {
+        if (v) throw 0;
+      }
+    };
+    lf::stack<thrower> s4(1);
+    REQUIRE_THROWS(s4.try_emplace(1));
+    REQUIRE(s4.try_emplace(0));
+  }
+  SECTION("pop in place") {
+    lf::stack<ci_t> stk(2);
+    REQUIRE(stk.try_push(ci_t(1)));
+    REQUIRE(stk.try_push(ci_t(2)));
+    int seen = 0;
+    REQUIRE(stk.try_pop_with([&seen](ci_t& c) { seen = c.cnt; }));
+    REQUIRE(seen == 2);
+    REQUIRE(ci_t::inst_cnt == 1);
+    REQUIRE_THROWS(stk.try_pop_with([](ci_t&) { throw 0; }));
+    REQUIRE(ci_t::inst_cnt == 0);
+    REQUIRE_FALSE(stk.try_pop_with([&seen](ci_t&) { seen = -1; }));
+    REQUIRE(seen == 2);
+    lf::stack<std::vector<int>> s2(2);
+    REQUIRE(s2.try_emplace(3, 1));
+    std::vector<int> out{5};
+    REQUIRE(s2.try_pop(out));
+    REQUIRE(out == std::vector<int>{1, 1, 1});
+    REQUIRE_FALSE(s2.try_pop(out));
+    REQUIRE(out.size() == 3);
+    REQUIRE(s2.try_emplace(1, 2));
+    REQUIRE(s2.try_emplace(1, 3));
+  }
+  SECTION("wait pop") {
+    using namespace std::chrono_literals;
+    lf::waitable_stack<ci_t> stk(4);
+    REQUIRE_FALSE(stk.wait_pop_for(1ms));
+    REQUIRE_FALSE(stk.wait_pop_for(-1ms));
+    REQUIRE_FALSE(stk.wait_pop_for(0.5ms));
+    REQUIRE_FALSE(stk.wait_pop_for(std::chrono::hours::min()));
+    REQUIRE(stk.try_push(ci_t(1)));
+    REQUIRE(stk.wait_pop_for(1ms).value().cnt == 1);
+    REQUIRE(stk.try_push(ci_t(2)));
+    REQUIRE(stk.wait_pop().cnt == 2);
+    int got = 0;
+    std::thread consumer([&stk, &got] { got = stk.wait_pop().cnt; });
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(stk.try_push(ci_t(3)));
+    consumer.join();
+    REQUIRE(got == 3);
+    std::optional<ci_t> timed;
+    consumer = std::thread([&stk, &timed] { timed = stk.wait_pop_for(10s); });
+    std::this_thread::sleep_for(10ms);
+    std::vector<ci_t> v{4, 5};
+    REQUIRE(stk.try_push_range(v.begin(), v.end()));
+    consumer.join();
+    REQUIRE(timed.value().cnt == 5);
+    REQUIRE(stk.try_pop().value().cnt == 4);
+    consumer = std::thread([&stk, &timed] {
+      timed = stk.wait_pop_for(std::chrono::hours::max());
+    });
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(stk.try_push(ci_t(6)));
+    consumer.join();
+    REQUIRE(timed.value().cnt == 6);
+    // Plain ints, as counted instances are not thread-safe.
+    lf::waitable_stack<int> istk(4);
+    std::vector<std::thread> consumers;
+    std::atomic_int sum{};
+    for (int t = 0; t < 4; ++t) {
+      consumers.emplace_back([&istk, &sum] {
+        for (int i = 0; i < 1000; ++i) {
+          sum += istk.wait_pop();
+        }
+      });
+    }
+    for (int i = 0; i < 4000; ++i) {
+      while (!istk.try_emplace(1)) std::this_thread::yield();
+    }
+    for (auto& t : consumers) {
+      t.join();
+    }
+    REQUIRE(sum == 4000);
+  }
+  SECTION("wait push") {
+    using namespace std::chrono_literals;
+    lf::stack<ci_t> stk(2);
+    stk.wait_push(ci_t(1));
+    REQUIRE(stk.wait_push_for(ci_t(2), 1ms));
+    REQUIRE_FALSE(stk.wait_push_for(ci_t(3), 1ms));
+    REQUIRE_FALSE(stk.wait_push_for(ci_t(3), -1ms));
+    REQUIRE_FALSE(stk.wait_push_for(ci_t(3), 0.5ms));
+    std::thread producer([&stk] { stk.wait_push(ci_t(3)); });
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(stk.try_pop().value().cnt == 2);
+    producer.join();
+    REQUIRE(stk.try_pop().value().cnt == 3);
+    bool timed = false;
+    producer = std::thread([&stk, &timed] {
+      stk.wait_push(ci_t(4));
+      timed = stk.wait_push_for(ci_t(5), 10s);
+    });
+    std::this_thread::sleep_for(10ms);
+    {
+      auto b = stk.pop_all();
+      REQUIRE_FALSE(b.empty());
+    }
+    producer.join();
+    REQUIRE(timed);
+    REQUIRE(stk.try_pop().value().cnt == 5);
+    lf::waitable_stack<int> istk(2);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+      producers.emplace_back([&istk] {
+        for (int i = 0; i < 1000; ++i) {
+          istk.wait_push(1);
+        }
+      });
+    }
+    int sum = 0;
+    while (sum < 4000) {
+      sum += istk.wait_pop();
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+    REQUIRE(sum == 4000);
+    REQUIRE_FALSE(istk.try_pop());
+  }
+  SECTION("magazine allocator") {
+    using mag_t = lf::magazine_allocator<ci_t, 4>;
+    REQUIRE_SAME_T(mag_t::cp_type, lf::cp_t);
+    lf::stack<ci_t, mag_t> s1(2);
+    require_capacity_2(s1);
+    mag_t pool(8, 1);
+    REQUIRE(pool.slot_cnt() == 1);
+    {
+      lf::stack<ci_t, mag_t&> s2(pool);
+      REQUIRE(s2.try_push(ci_t(1)));
+      REQUIRE(s2.try_pop().value().cnt == 1);
+      REQUIRE(s2.try_push(ci_t(2)));
+      // Nodes 0 and 1 went to the magazine, so the pool is untouched.
+      REQUIRE(pool.base().try_allocate() == 2);
+      pool.base().deallocate(2);
+      REQUIRE(s2.try_push(ci_t(3)));
+      REQUIRE(s2.try_push(ci_t(4)));
+    }
+    REQUIRE(ci_t::inst_cnt == 0);
+    pool.flush();
+    lf::magazine_allocator<int, 4> shared(64, 2);
+    lf::stack<int, lf::magazine_allocator<int, 4>&> s3(shared);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&s3, t] {
+        for (int i = 0; i < 10000; ++i) {
+          (void)s3.try_push(t * 10000 + i);
+          (void)s3.try_pop();
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    while (s3.try_pop());
+    shared.flush();
+    int cnt = 0;
+    while (s3.try_push(0)) ++cnt;
+    REQUIRE(cnt == 64);
+    lf::magazine_allocator<int, 4> mags(8, 2);
+    lf::stack<int, lf::magazine_allocator<int, 4>&> s4(mags);
+    // Nodes cached by the filling thread are reclaimed by the other.
+    std::thread([&s4] {
+      while (s4.try_push(0));
+      while (s4.try_pop());
+    }).join();
+    cnt = 0;
+    std::thread([&s4, &cnt] {
+      while (s4.try_push(0)) ++cnt;
+    }).join();
+    REQUIRE(cnt == 8);
+  }
+  SECTION("sharded allocator") {
+    lf::stack<ci_t, lf::sharded_allocator<ci_t>> s(2);
+    require_capacity_2(s);
+  }
 }
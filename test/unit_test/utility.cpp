@@ -3,6 +3,8 @@
 
 #include "test.hpp"
 
+#include <thread>
+
 TEST_CASE("utility") {
   SECTION("memory order shorthand") {
     REQUIRE_SAME_T(decltype(lf::rlx), const std::memory_order);
@@ -26,4 +28,47 @@ TEST_CASE("utility") {
     REQUIRE(cp.cnt == 0);
     REQUIRE(std::atomic<lf::cp_t>(cp).is_lock_free());
   }
+  SECTION("basic_cp") {
+    using cp16_t = lf::basic_cp<16>;
+    using cp40_t = lf::basic_cp<40>;
+    REQUIRE_SAME_T(lf::cp_t, lf::basic_cp<32>);
+    REQUIRE_SAME_T(cp16_t::index_type, std::uint32_t);
+    REQUIRE_SAME_T(cp40_t::index_type, std::uint64_t);
+    static_assert(cp16_t::null == 0xffff);
+    static_assert(cp40_t::null == 0xff'ffff'ffff);
+    static_assert(sizeof(cp16_t) == 8 && sizeof(cp40_t) == 8);
+    cp16_t cp;
+    REQUIRE(cp.ptr == cp16_t::null);
+    REQUIRE(cp.cnt == 0);
+    cp.cnt = (std::uint64_t(1) << 48) - 1;
+    cp.cnt = cp.cnt + 1;
+    REQUIRE(cp.cnt == 0);
+    REQUIRE(cp.ptr == cp16_t::null);
+    cp40_t cp2{cp40_t::null - 1, 3};
+    REQUIRE(cp2.ptr == cp40_t::null - 1);
+    REQUIRE(cp2.cnt == 3);
+    REQUIRE(std::atomic<cp40_t>(cp2).is_lock_free());
+  }
+  SECTION("ilog2") {
+    static_assert(lf::ilog2(1) == 0);
+    static_assert(lf::ilog2(2) == 1);
+    static_assert(lf::ilog2(3) == 1);
+    static_assert(lf::ilog2(4) == 2);
+    static_assert(lf::ilog2(std::uint64_t(-1)) == 63);
+  }
+  SECTION("thread_index") {
+    auto idx = lf::thread_index();
+    REQUIRE(lf::thread_index() == idx);
+    std::uint32_t other;
+    std::thread([&other] { other = lf::thread_index(); }).join();
+    REQUIRE(other != idx);
+  }
+  SECTION("thread_random") {
+    auto a = lf::thread_random();
+    auto b = lf::thread_random();
+    REQUIRE(a != b);
+    std::uint32_t c;
+    std::thread([&c] { c = lf::thread_random(); }).join();
+    REQUIRE(c != a);
+  }
 }